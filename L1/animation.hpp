@@ -0,0 +1,45 @@
+// векторизованный расчет позиций анимированных точек
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "../common/sincos.hpp"
+
+// position = start + radius * (cos(phase + offset), sin(phase + offset)) за один проход по массивам;
+// точки с ненулевым флагом dragging остаются на месте
+inline void animatePoints(const float* startX, const float* startY, const float* angleOffset, const std::uint8_t* dragging,
+	float* positionX, float* positionY, size_t count, float phase, float radius)
+{
+	size_t i = 0;
+#ifdef SINCOS_USE_SSE2
+	const __m128 phase4 = _mm_set1_ps(phase);
+	const __m128 radius4 = _mm_set1_ps(radius);
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 sinValue, cosValue;
+		sinCos4(_mm_add_ps(phase4, _mm_loadu_ps(angleOffset + i)), sinValue, cosValue);
+		__m128 newX = _mm_add_ps(_mm_loadu_ps(startX + i), _mm_mul_ps(radius4, cosValue));
+		__m128 newY = _mm_add_ps(_mm_loadu_ps(startY + i), _mm_mul_ps(radius4, sinValue));
+
+		// расширяем 4 байта флагов до масок по 32 бита
+		std::int32_t packed;
+		std::memcpy(&packed, dragging + i, sizeof(packed));
+		__m128i flags = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+		__m128 keep = _mm_castsi128_ps(_mm_cmpgt_epi32(flags, zero));
+
+		_mm_storeu_ps(positionX + i, _mm_or_ps(_mm_and_ps(keep, _mm_loadu_ps(positionX + i)), _mm_andnot_ps(keep, newX)));
+		_mm_storeu_ps(positionY + i, _mm_or_ps(_mm_and_ps(keep, _mm_loadu_ps(positionY + i)), _mm_andnot_ps(keep, newY)));
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		if (dragging[i]) continue;
+		float sinValue, cosValue;
+		sinCos(phase + angleOffset[i], sinValue, cosValue);
+		positionX[i] = startX[i] + radius * cosValue;
+		positionY[i] = startY[i] + radius * sinValue;
+	}
+}
@@ -0,0 +1,223 @@
+// хранилище контрольных точек
+
+#pragma once
+
+#include <SFML/System.hpp>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "animation.hpp"
+
+// Структура для представления контрольной точки (при добавлении в хранилище)
+struct ControlPoint
+{
+	sf::Vector2f startPosition; // Начальная позиция точки
+	sf::Vector2f position;      // Текущая позиция точки
+	bool isDragging = false;
+	float angleOffset = 0.0f;   // Угол для анимации движения
+};
+
+// Ссылка на точку в хранилище. После удаления точки ее ячейка получает новое поколение,
+// поэтому старая ссылка перестает быть действительной, даже если ячейку заняла другая точка.
+struct PointHandle
+{
+	static const std::uint32_t NONE = 0xFFFFFFFFu;
+
+	std::uint32_t index = NONE;  // номер ячейки в таблице
+	std::uint32_t generation = 0;
+
+	bool operator==(const PointHandle& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const PointHandle& other) const { return !(*this == other); }
+};
+
+// Таблица ячеек с поколениями (slot map) над плотными массивами полей точек.
+// Вставка и удаление - O(1): при удалении на место точки в плотных массивах переносится последняя,
+// ссылки (PointHandle) при этом не меняются. Анимация и отрисовка идут по плотным массивам без пропусков.
+// Порядок точек на кривой хранится двусвязным списком по ячейкам.
+class ControlPointStore
+{
+public:
+	// добавляем точку в конец кривой
+	PointHandle add(const ControlPoint& point)
+	{
+		std::uint32_t slot;
+		if (firstFreeSlot != PointHandle::NONE)
+		{
+			slot = firstFreeSlot;
+			firstFreeSlot = slots[slot].denseIndex; // у свободной ячейки здесь хранится следующая свободная
+		}
+		else
+		{
+			slot = static_cast<std::uint32_t>(slots.size());
+			slots.push_back(Slot());
+		}
+
+		slots[slot].denseIndex = static_cast<std::uint32_t>(denseToSlot.size());
+		slots[slot].alive = true;
+		denseToSlot.push_back(slot);
+		startX.push_back(point.startPosition.x);
+		startY.push_back(point.startPosition.y);
+		// угол приводим к [0, 2pi), чтобы при большом числе точек не терять точность синуса
+		angleOffsets.push_back(static_cast<float>(std::fmod(static_cast<double>(point.angleOffset), 2.0 * 3.14159265358979323846)));
+		positionX.push_back(point.position.x);
+		positionY.push_back(point.position.y);
+		dragging.push_back(point.isDragging ? 1 : 0);
+
+		slots[slot].previous = last;
+		slots[slot].next = PointHandle::NONE;
+		if (last != PointHandle::NONE) slots[last].next = slot;
+		else first = slot;
+		last = slot;
+
+		return handleAt(slot);
+	}
+
+	// добавление сразу многих точек в конец кривой (текущие позиции совпадают с начальными, углы уже приведены к [0, 2pi)):
+	// поля копируются в плотные массивы целиком, по отдельности заполняются только ячейки
+	void append(const float* x, const float* y, const float* angle, size_t count)
+	{
+		if (count == 0) return;
+		std::uint32_t firstNewSlot = static_cast<std::uint32_t>(slots.size());
+		std::uint32_t firstNewDense = static_cast<std::uint32_t>(denseToSlot.size());
+		startX.insert(startX.end(), x, x + count);
+		startY.insert(startY.end(), y, y + count);
+		angleOffsets.insert(angleOffsets.end(), angle, angle + count);
+		positionX.insert(positionX.end(), x, x + count);
+		positionY.insert(positionY.end(), y, y + count);
+		dragging.resize(dragging.size() + count, 0);
+
+		// новые точки занимают новые ячейки подряд и идут по кривой друг за другом
+		slots.resize(slots.size() + count);
+		denseToSlot.resize(denseToSlot.size() + count);
+		for (std::uint32_t i = 0; i < count; ++i)
+		{
+			std::uint32_t slot = firstNewSlot + i;
+			slots[slot].denseIndex = firstNewDense + i;
+			slots[slot].alive = true;
+			slots[slot].previous = i > 0 ? slot - 1 : last;
+			slots[slot].next = i + 1 < count ? slot + 1 : PointHandle::NONE;
+			denseToSlot[firstNewDense + i] = slot;
+		}
+		if (last != PointHandle::NONE) slots[last].next = firstNewSlot;
+		else first = firstNewSlot;
+		last = firstNewSlot + static_cast<std::uint32_t>(count) - 1;
+	}
+
+	// удаление по недействительной ссылке ничего не делает
+	void remove(PointHandle handle)
+	{
+		if (!contains(handle)) return;
+		Slot& removed = slots[handle.index];
+
+		// убираем из списка кривой
+		if (removed.previous != PointHandle::NONE) slots[removed.previous].next = removed.next;
+		else first = removed.next;
+		if (removed.next != PointHandle::NONE) slots[removed.next].previous = removed.previous;
+		else last = removed.previous;
+
+		// на освободившееся место в плотных массивах переносим последнюю точку
+		std::uint32_t dense = removed.denseIndex;
+		std::uint32_t lastDense = static_cast<std::uint32_t>(denseToSlot.size() - 1);
+		if (dense != lastDense)
+		{
+			std::uint32_t movedSlot = denseToSlot[lastDense];
+			denseToSlot[dense] = movedSlot;
+			startX[dense] = startX[lastDense];
+			startY[dense] = startY[lastDense];
+			angleOffsets[dense] = angleOffsets[lastDense];
+			positionX[dense] = positionX[lastDense];
+			positionY[dense] = positionY[lastDense];
+			dragging[dense] = dragging[lastDense];
+			slots[movedSlot].denseIndex = dense;
+		}
+		denseToSlot.pop_back();
+		startX.pop_back();
+		startY.pop_back();
+		angleOffsets.pop_back();
+		positionX.pop_back();
+		positionY.pop_back();
+		dragging.pop_back();
+
+		// ячейка уходит в список свободных с новым поколением
+		removed.alive = false;
+		++removed.generation;
+		removed.denseIndex = firstFreeSlot;
+		firstFreeSlot = handle.index;
+	}
+
+	bool contains(PointHandle handle) const
+	{
+		return handle.index < slots.size() && slots[handle.index].alive && slots[handle.index].generation == handle.generation;
+	}
+
+	// действительная ссылка на занятую ячейку (например, по id из сетки)
+	PointHandle handleAt(std::uint32_t slot) const
+	{
+		PointHandle handle;
+		handle.index = slot;
+		handle.generation = slots[slot].generation;
+		return handle;
+	}
+
+	sf::Vector2f position(PointHandle handle) const { return positionAt(slots[handle.index].denseIndex); }
+	sf::Vector2f startPosition(PointHandle handle) const { return startPositionAt(slots[handle.index].denseIndex); }
+	float angleOffset(PointHandle handle) const { return angleOffsets[slots[handle.index].denseIndex]; }
+	bool isDragging(PointHandle handle) const { return dragging[slots[handle.index].denseIndex] != 0; }
+	void setDragging(PointHandle handle, bool value) { dragging[slots[handle.index].denseIndex] = value ? 1 : 0; }
+
+	// перетаскивание: точка ставится в позицию мыши, начальная позиция тоже обновляется
+	void moveTo(PointHandle handle, const sf::Vector2f& position)
+	{
+		std::uint32_t dense = slots[handle.index].denseIndex;
+		positionX[dense] = startX[dense] = position.x;
+		positionY[dense] = startY[dense] = position.y;
+	}
+
+	// новые позиции всех неперетаскиваемых точек для момента времени time
+	void animate(float time, float radius)
+	{
+		// фазу тоже приводим к [0, 2pi): синус считается точнее на малых углах
+		float phase = static_cast<float>(std::fmod(static_cast<double>(time), 2.0 * 3.14159265358979323846));
+		animatePoints(startX.data(), startY.data(), angleOffsets.data(), dragging.data(),
+			positionX.data(), positionY.data(), size(), phase, radius);
+	}
+
+	// плотный обход: for (size_t i = 0; i < store.size(); ++i) store.positionAt(i)
+	size_t size() const { return denseToSlot.size(); }
+	sf::Vector2f positionAt(size_t dense) const { return sf::Vector2f(positionX[dense], positionY[dense]); }
+	sf::Vector2f startPositionAt(size_t dense) const { return sf::Vector2f(startX[dense], startY[dense]); }
+
+	// обход в порядке кривой: for (PointHandle h = store.front(); store.contains(h); h = store.next(h))
+	PointHandle front() const { return first != PointHandle::NONE ? handleAt(first) : PointHandle(); }
+	PointHandle next(PointHandle handle) const
+	{
+		std::uint32_t slot = slots[handle.index].next;
+		return slot != PointHandle::NONE ? handleAt(slot) : PointHandle();
+	}
+
+	// количество ячеек вместе со свободными (номера ячеек лежат в [0, slotCount))
+	size_t slotCount() const { return slots.size(); }
+
+private:
+	struct Slot
+	{
+		std::uint32_t denseIndex = 0; // место в плотных массивах (у свободной ячейки - следующая свободная)
+		std::uint32_t generation = 0;
+		std::uint32_t previous = PointHandle::NONE; // соседи по кривой
+		std::uint32_t next = PointHandle::NONE;
+		bool alive = false;
+	};
+
+	std::vector<Slot> slots;
+	std::uint32_t firstFreeSlot = PointHandle::NONE;
+	std::uint32_t first = PointHandle::NONE;
+	std::uint32_t last = PointHandle::NONE;
+
+	// плотные массивы полей (SoA)
+	std::vector<std::uint32_t> denseToSlot;  // ячейка каждой точки
+	std::vector<float> startX, startY;       // начальные позиции
+	std::vector<float> angleOffsets;         // сдвиги фазы анимации
+	std::vector<float> positionX, positionY; // текущие позиции
+	std::vector<std::uint8_t> dragging;      // маска перетаскиваемых точек
+};
@@ -0,0 +1,188 @@
+// гладкая кривая через контрольные точки с адаптивным разбиением на отрезки
+
+#pragma once
+
+#include <SFML/System.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "control_points.hpp"
+
+// Вид кривой
+enum class CurveMode
+{
+	Polyline,   // ломаная через точки (как раньше)
+	CatmullRom, // сплайн Катмулла-Рома, проходит через все точки
+	Bezier      // составная кубическая кривая Безье: точки 0-3, 3-6, ... (концы сегментов общие)
+};
+
+// Кривая собирается из кубических сегментов Безье (сплайн Катмулла-Рома переводится в них же).
+// Каждый сегмент разбивается на отрезки, пока он не станет достаточно плоским, результат кешируется
+// вместе с опорными точками. При следующем обновлении сегмент перестраивается, только если его опорные
+// точки изменились, так что при перетаскивании пересчитываются лишь сегменты, зависящие от этой точки.
+class CurveTessellator
+{
+public:
+	explicit CurveTessellator(float tolerance = 0.25f)
+		: tolerance(tolerance)
+	{
+	}
+
+	void setMode(CurveMode newMode) { mode = newMode; }
+	CurveMode getMode() const { return mode; }
+
+	// точки ломаной, приближающей кривую, в порядке кривой
+	const std::vector<sf::Vector2f>& update(const ControlPointStore& points)
+	{
+		positions.clear();
+		slots.clear();
+		for (PointHandle point = points.front(); points.contains(point); point = points.next(point))
+		{
+			positions.push_back(points.position(point));
+			slots.push_back(point.index);
+		}
+		if (cache.size() < points.slotCount()) cache.resize(points.slotCount());
+
+		output.clear();
+		retessellated = 0;
+		size_t count = positions.size();
+		if (mode == CurveMode::Polyline || count < 2)
+		{
+			output = positions;
+			return output;
+		}
+
+		output.push_back(positions[0]);
+		if (mode == CurveMode::CatmullRom)
+		{
+			for (size_t i = 0; i + 1 < count; ++i)
+			{
+				// на концах недостающую соседнюю точку заменяем крайней
+				const sf::Vector2f& p0 = positions[i > 0 ? i - 1 : 0];
+				const sf::Vector2f& p1 = positions[i];
+				const sf::Vector2f& p2 = positions[i + 1];
+				const sf::Vector2f& p3 = positions[std::min(i + 2, count - 1)];
+
+				// тот же сегмент в форме Безье
+				sf::Vector2f control[4] = {
+					p1,
+					sf::Vector2f(p1.x + (p2.x - p0.x) / 6.0f, p1.y + (p2.y - p0.y) / 6.0f),
+					sf::Vector2f(p2.x - (p3.x - p1.x) / 6.0f, p2.y - (p3.y - p1.y) / 6.0f),
+					p2
+				};
+				appendSegment(slots[i], control);
+			}
+		}
+		else
+		{
+			size_t i = 0;
+			for (; i + 3 < count; i += 3)
+			{
+				sf::Vector2f control[4] = { positions[i], positions[i + 1], positions[i + 2], positions[i + 3] };
+				appendSegment(slots[i], control);
+			}
+
+			// хвост из трех точек - квадратичная кривая, записанная как кубическая
+			if (i + 2 == count - 1)
+			{
+				const sf::Vector2f& q0 = positions[i];
+				const sf::Vector2f& q1 = positions[i + 1];
+				const sf::Vector2f& q2 = positions[i + 2];
+				sf::Vector2f control[4] = {
+					q0,
+					sf::Vector2f(q0.x + 2.0f / 3.0f * (q1.x - q0.x), q0.y + 2.0f / 3.0f * (q1.y - q0.y)),
+					sf::Vector2f(q2.x + 2.0f / 3.0f * (q1.x - q2.x), q2.y + 2.0f / 3.0f * (q1.y - q2.y)),
+					q2
+				};
+				appendSegment(slots[i], control);
+			}
+			// хвост из двух точек - отрезок
+			else if (i + 1 == count - 1)
+			{
+				output.push_back(positions[i + 1]);
+			}
+		}
+		return output;
+	}
+
+	// сколько сегментов пришлось перестроить при последнем обновлении
+	size_t retessellatedSegments() const { return retessellated; }
+
+private:
+	struct Segment
+	{
+		sf::Vector2f control[4];
+		std::vector<sf::Vector2f> samples; // точки разбиения без первой (она совпадает с концом предыдущего сегмента)
+		bool valid = false;
+	};
+
+	// сегмент хранится в ячейке своей первой точки
+	void appendSegment(std::uint32_t slot, const sf::Vector2f control[4])
+	{
+		Segment& segment = cache[slot];
+		if (!segment.valid || !std::equal(control, control + 4, segment.control))
+		{
+			std::copy(control, control + 4, segment.control);
+			segment.samples.clear();
+			subdivide(control[0], control[1], control[2], control[3], 0, segment.samples);
+			segment.valid = true;
+			++retessellated;
+		}
+		output.insert(output.end(), segment.samples.begin(), segment.samples.end());
+	}
+
+	// рекурсивное деление пополам (алгоритм де Кастельжо), пока контрольные точки не лягут близко к хорде
+	void subdivide(const sf::Vector2f& p0, const sf::Vector2f& p1, const sf::Vector2f& p2, const sf::Vector2f& p3,
+		int depth, std::vector<sf::Vector2f>& samples) const
+	{
+		const int maxDepth = 12;
+		if (depth >= maxDepth || isFlat(p0, p1, p2, p3))
+		{
+			samples.push_back(p3);
+			return;
+		}
+
+		sf::Vector2f p01 = midpoint(p0, p1), p12 = midpoint(p1, p2), p23 = midpoint(p2, p3);
+		sf::Vector2f p012 = midpoint(p01, p12), p123 = midpoint(p12, p23);
+		sf::Vector2f middle = midpoint(p012, p123);
+		subdivide(p0, p01, p012, middle, depth + 1, samples);
+		subdivide(middle, p123, p23, p3, depth + 1, samples);
+	}
+
+	// отклонение внутренних контрольных точек от хорды не больше допуска (в пикселях)
+	bool isFlat(const sf::Vector2f& p0, const sf::Vector2f& p1, const sf::Vector2f& p2, const sf::Vector2f& p3) const
+	{
+		float dx = p3.x - p0.x;
+		float dy = p3.y - p0.y;
+		float length2 = dx * dx + dy * dy;
+		float d1, d2;
+		if (length2 < 1e-12f)
+		{
+			d1 = (p1.x - p0.x) * (p1.x - p0.x) + (p1.y - p0.y) * (p1.y - p0.y);
+			d2 = (p2.x - p0.x) * (p2.x - p0.x) + (p2.y - p0.y) * (p2.y - p0.y);
+		}
+		else
+		{
+			float cross1 = (p1.x - p0.x) * dy - (p1.y - p0.y) * dx;
+			float cross2 = (p2.x - p0.x) * dy - (p2.y - p0.y) * dx;
+			d1 = cross1 * cross1 / length2;
+			d2 = cross2 * cross2 / length2;
+		}
+		return std::max(d1, d2) <= tolerance * tolerance;
+	}
+
+	static sf::Vector2f midpoint(const sf::Vector2f& a, const sf::Vector2f& b)
+	{
+		return sf::Vector2f((a.x + b.x) * 0.5f, (a.y + b.y) * 0.5f);
+	}
+
+	float tolerance;
+	CurveMode mode = CurveMode::Polyline;
+	std::vector<Segment> cache;            // кеш сегментов по номеру ячейки первой точки
+	std::vector<sf::Vector2f> positions;   // позиции точек в порядке кривой
+	std::vector<std::uint32_t> slots;      // ячейки точек в порядке кривой
+	std::vector<sf::Vector2f> output;
+	size_t retessellated = 0;
+};
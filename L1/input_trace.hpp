@@ -0,0 +1,143 @@
+// запись и воспроизведение событий ввода по кадрам
+
+#pragma once
+
+#include <SFML/Window.hpp>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Все, что программа получает от пользователя за один кадр: время анимации, позиция курсора
+// (нужна клавишам C и D) и события окна.
+struct InputFrame
+{
+	float time = 0.0f;
+	sf::Vector2f cursor;
+	std::vector<sf::Event> events;
+};
+
+// Текстовый формат, по строке на кадр и на событие:
+//   F <время> <курсор x> <курсор y>
+//   E <тип события> <поля события>
+// Сохраняются только события, которые обрабатывает программа (закрытие окна, мышь, клавиши).
+class InputTraceWriter
+{
+public:
+	explicit InputTraceWriter(const std::string& fileName)
+		: file(fileName)
+	{
+		file.precision(9); // время записываем без потери точности float
+	}
+
+	bool isOpen() const { return file.is_open(); }
+
+	void write(const InputFrame& frame)
+	{
+		file << "F " << frame.time << ' ' << frame.cursor.x << ' ' << frame.cursor.y << '\n';
+		for (const sf::Event& event : frame.events)
+		{
+			switch (event.type)
+			{
+			case sf::Event::Closed:
+				file << "E " << event.type << '\n';
+				break;
+			case sf::Event::MouseButtonPressed:
+			case sf::Event::MouseButtonReleased:
+				file << "E " << event.type << ' ' << event.mouseButton.button << ' ' << event.mouseButton.x << ' ' << event.mouseButton.y << '\n';
+				break;
+			case sf::Event::MouseMoved:
+				file << "E " << event.type << ' ' << event.mouseMove.x << ' ' << event.mouseMove.y << '\n';
+				break;
+			case sf::Event::KeyPressed:
+			case sf::Event::KeyReleased:
+				file << "E " << event.type << ' ' << event.key.code << '\n';
+				break;
+			default:
+				break;
+			}
+		}
+	}
+
+private:
+	std::ofstream file;
+};
+
+// Читает кадры, записанные InputTraceWriter, по одному
+class InputTraceReader
+{
+public:
+	explicit InputTraceReader(const std::string& fileName)
+		: file(fileName)
+	{
+	}
+
+	bool isOpen() const { return file.is_open(); }
+
+	// false, когда кадры закончились
+	bool read(InputFrame& frame)
+	{
+		frame.events.clear();
+		std::string line;
+		bool haveFrame = false;
+		while (true)
+		{
+			// строка следующего кадра уже прочитана на прошлом вызове
+			if (!pendingLine.empty())
+			{
+				line.swap(pendingLine);
+				pendingLine.clear();
+			}
+			else if (!std::getline(file, line))
+			{
+				return haveFrame;
+			}
+
+			std::istringstream fields(line);
+			char kind = 0;
+			fields >> kind;
+			if (kind == 'F')
+			{
+				if (haveFrame)
+				{
+					pendingLine = line;
+					return true;
+				}
+				fields >> frame.time >> frame.cursor.x >> frame.cursor.y;
+				haveFrame = true;
+			}
+			else if (kind == 'E' && haveFrame)
+			{
+				int type = 0;
+				fields >> type;
+				sf::Event event;
+				event.type = static_cast<sf::Event::EventType>(type);
+				int button = 0, code = 0;
+				switch (event.type)
+				{
+				case sf::Event::MouseButtonPressed:
+				case sf::Event::MouseButtonReleased:
+					fields >> button >> event.mouseButton.x >> event.mouseButton.y;
+					event.mouseButton.button = static_cast<sf::Mouse::Button>(button);
+					break;
+				case sf::Event::MouseMoved:
+					fields >> event.mouseMove.x >> event.mouseMove.y;
+					break;
+				case sf::Event::KeyPressed:
+				case sf::Event::KeyReleased:
+					fields >> code;
+					event.key.code = static_cast<sf::Keyboard::Key>(code);
+					event.key.alt = event.key.control = event.key.shift = event.key.system = false;
+					break;
+				default:
+					break;
+				}
+				frame.events.push_back(event);
+			}
+		}
+	}
+
+private:
+	std::ifstream file;
+	std::string pendingLine;
+};
@@ -2,19 +2,30 @@
 #include <SFML/OpenGL.hpp>
 #include <vector>
 #include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+ 
+#include "control_points.hpp"
+#include "curve.hpp"
+#include "input_trace.hpp"
+#include "point_file.hpp"
+#include "point_grid.hpp"
+#include "point_markers.hpp"
+#include "../common/microbench.hpp"
+#include "../common/profiler.hpp"
  
 const float POINT_RADIUS = 10.0f; // Радиус отображаемых контрольных точек
 const float MOVEMENT_RADIUS = 20.0f; // Радиус движения точек
 const float MOVEMENT_SPEED = 1.0f; // Скорость движения точек
  
-// Структура для представления контрольной точки
-struct ControlPoint 
-{
-	sf::Vector2f startPosition; // Начальная позиция точки
-	sf::Vector2f position;      // Текущая позиция точки
-	bool isDragging = false;
-	float angleOffset = 0.0f;   // Угол для анимации движения
-};
+// Точка всегда находится не дальше MOVEMENT_RADIUS от начальной позиции, поэтому сетка индексирует начальные позиции:
+// при анимации их ячейки не меняются, а точку под курсором достаточно искать в соседних ячейках
+const float GRID_CELL_SIZE = POINT_RADIUS + MOVEMENT_RADIUS;
  
 // Проверка, наведена ли мышь на точку
 bool isPointHovered(const sf::Vector2f& mousePos, const sf::Vector2f& pointPos) 
@@ -24,36 +35,305 @@ bool isPointHovered(const sf::Vector2f& mousePos, const sf::Vector2f& pointPos)
 	return std::sqrt(dx * dx + dy * dy) <= POINT_RADIUS;
 }
  
-// Обновление позиции точки для анимации
-void updatePointPosition(ControlPoint& point, float time) 
+// Поиск ближайшей точки под курсором через сетку (недействительная ссылка, если такой нет)
+PointHandle findHoveredPoint(const ControlPointStore& controlPoints, const PointGrid& grid, const sf::Vector2f& mousePos)
+{
+	PointHandle hovered;
+	float bestDistance = 0.0f;
+	grid.query(mousePos.x, mousePos.y, [&](int index)
+	{
+		PointHandle point = controlPoints.handleAt(static_cast<std::uint32_t>(index));
+		sf::Vector2f position = controlPoints.position(point);
+		if (isPointHovered(mousePos, position))
+		{
+			float dx = mousePos.x - position.x;
+			float dy = mousePos.y - position.y;
+			float distance = dx * dx + dy * dy;
+			if (!controlPoints.contains(hovered) || distance < bestDistance)
+			{
+				hovered = point;
+				bestDistance = distance;
+			}
+		}
+	});
+	return hovered;
+}
+ 
+// Добавление точки в хранилище и сетку (в сетке точка хранится под номером своей ячейки)
+void addControlPoint(ControlPointStore& controlPoints, PointGrid& grid, const ControlPoint& point)
+{
+	PointHandle handle = controlPoints.add(point);
+	grid.insert(static_cast<int>(handle.index), point.startPosition.x, point.startPosition.y);
+}
+ 
+// Обновление позиций всех точек для анимации одним векторизованным проходом (перетаскиваемые точки не двигаются)
+void updatePointPositions(ControlPointStore& controlPoints, float time) 
+{
+	controlPoints.animate(time, MOVEMENT_RADIUS);
+}
+ 
+// Среднее, перцентили и худший кадр одного ряда времен в миллисекундах
+void printTimeStats(const char* title, const std::vector<double>& times)
+{
+	if (times.empty()) return;
+	size_t worstFrame = std::max_element(times.begin(), times.end()) - times.begin();
+	std::vector<double> sorted = times;
+	std::sort(sorted.begin(), sorted.end());
+	double total = 0.0;
+	for (double time : sorted) total += time;
+	auto percentile = [&](double p) { return sorted[std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()))]; };
+ 
+	std::cout << title << " (ms): avg " << total / sorted.size()
+		<< ", min " << sorted.front()
+		<< ", p50 " << percentile(0.50)
+		<< ", p90 " << percentile(0.90)
+		<< ", p99 " << percentile(0.99)
+		<< ", max " << sorted.back() << " (frame " << worstFrame << ")" << std::endl;
+}
+ 
+// Статистика кадров воспроизведения. Работа кадра - от начала обработки ввода до display: в display
+// ограничитель частоты ждет до 1/60 секунды, это ожидание показывает только промежуток между началами кадров
+void printFrameStats(const std::vector<double>& workTimes, const std::vector<double>& frameIntervals)
+{
+	if (workTimes.empty()) return;
+	double total = 0.0;
+	for (double time : workTimes) total += time;
+	std::cout << "Frames: " << workTimes.size() << ", work total " << total << " ms" << std::endl;
+	printTimeStats("Frame work time", workTimes);
+	printTimeStats("Frame interval", frameIntervals);
+}
+ 
+// Файл со случайными точками в пределах окна для проверки редактора на больших наборах
+int generatePointFile(const std::string& fileName, size_t count)
+{
+	std::mt19937 generator(12345);
+	std::uniform_real_distribution<float> coordinate(0.0f, 800.0f);
+	std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+	std::vector<float> x(count), y(count), angles(count);
+	for (size_t i = 0; i < count; ++i) 
+	{
+		x[i] = coordinate(generator);
+		y[i] = coordinate(generator);
+		angles[i] = angle(generator);
+	}
+	if (!writePointFile(fileName, x.data(), y.data(), angles.data(), count)) 
+	{
+		std::cerr << "Cannot write " << fileName << std::endl;
+		return 1;
+	}
+	std::cout << "Generated " << count << " points in " << fileName << std::endl;
+	return 0;
+}
+ 
+// Загрузка точек из файла и добавление их в сетку
+bool loadControlPoints(const std::string& fileName, ControlPointStore& controlPoints, PointGrid& grid)
 {
-	point.position.x = point.startPosition.x + MOVEMENT_RADIUS * std::cos(time + point.angleOffset);
-	point.position.y = point.startPosition.y + MOVEMENT_RADIUS * std::sin(time + point.angleOffset);
+	auto start = std::chrono::steady_clock::now();
+	long long loaded = loadPoints(fileName, controlPoints);
+	if (loaded < 0) 
+	{
+		std::cerr << "Cannot load " << fileName << std::endl;
+		return false;
+	}
+	auto mapped = std::chrono::steady_clock::now();
+ 
+	grid.reserve(controlPoints.size());
+	for (PointHandle point = controlPoints.front(); controlPoints.contains(point); point = controlPoints.next(point)) 
+	{
+		sf::Vector2f start = controlPoints.startPosition(point);
+		grid.insert(static_cast<int>(point.index), start.x, start.y);
+	}
+	auto indexed = std::chrono::steady_clock::now();
+ 
+	std::cout << "Loaded " << loaded << " points from " << fileName
+		<< " in " << std::chrono::duration<double, std::milli>(mapped - start).count() << " ms"
+		<< " (grid " << std::chrono::duration<double, std::milli>(indexed - mapped).count() << " ms)" << std::endl;
+	return true;
+}
+ 
+// Замер функций кадра по отдельности на случайных точках и положениях мыши (зерно фиксированное):
+// проверка наведения, поиск точки под курсором через сетку и анимация всего набора точек
+int runKernelBenchmark(const std::string& filter)
+{
+	const size_t INPUTS = 1024; // степень двойки: номер входа - i & (INPUTS - 1)
+	const size_t POINT_COUNT = 100000;
+	std::mt19937 generator(12345);
+	std::uniform_real_distribution<float> coordinate(0.0f, 800.0f);
+	std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+	std::uniform_real_distribution<float> offset(-2.0f * POINT_RADIUS, 2.0f * POINT_RADIUS);
+
+	// точки набора как в файле --generate, мышь - рядом со случайной точкой (часть проверок попадает, часть нет)
+	std::vector<float> x(POINT_COUNT), y(POINT_COUNT), angles(POINT_COUNT);
+	for (size_t i = 0; i < POINT_COUNT; ++i) 
+	{
+		x[i] = coordinate(generator);
+		y[i] = coordinate(generator);
+		angles[i] = angle(generator);
+	}
+	std::vector<sf::Vector2f> mouse(INPUTS), points(INPUTS);
+	for (size_t i = 0; i < INPUTS; ++i) 
+	{
+		size_t point = generator() % POINT_COUNT;
+		points[i] = sf::Vector2f(x[point], y[point]);
+		mouse[i] = sf::Vector2f(x[point] + offset(generator), y[point] + offset(generator));
+	}
+
+	ControlPointStore controlPoints;
+	PointGrid grid(GRID_CELL_SIZE);
+	controlPoints.append(x.data(), y.data(), angles.data(), POINT_COUNT);
+	grid.reserve(controlPoints.size());
+	for (PointHandle point = controlPoints.front(); controlPoints.contains(point); point = controlPoints.next(point)) 
+	{
+		sf::Vector2f start = controlPoints.startPosition(point);
+		grid.insert(static_cast<int>(point.index), start.x, start.y);
+	}
+
+	MicroBenchmark bench(filter);
+	bench.run("isPointHovered", [&](size_t i) 
+	{
+		keepResult(isPointHovered(mouse[i & (INPUTS - 1)], points[i & (INPUTS - 1)]));
+	});
+	bench.run("findHoveredPoint (100000 points)", [&](size_t i) 
+	{
+		keepResult(findHoveredPoint(controlPoints, grid, mouse[i & (INPUTS - 1)]));
+	});
+	bench.run("updatePointPositions (100000 points)", [&](size_t i) 
+	{
+		updatePointPositions(controlPoints, static_cast<float>(i) / 60.0f);
+		keepResult(controlPoints.position(controlPoints.front()));
+	}, static_cast<double>(POINT_COUNT));
+	return 0;
 }
  
-int main() {
+// Режимы запуска:
+//   без аргументов                       - обычная работа
+//   --record <файл>                      - обычная работа, ввод каждого кадра записывается в файл
+//   --replay <файл> [--unthrottled]      - ввод берется из файла, кадры идут с частотой 60 в секунду
+//                                          (или без ограничения), в конце - время работы кадров и промежутки между ними
+//   --load <файл>                        - начать с точек из файла (клавиша S сохраняет точки в этот же файл)
+//   --generate <файл> <количество>       - записать файл со случайными точками и выйти
+//   --kernel-bench [фильтр]              - замер функций кадра по отдельности (только с фильтром в имени) без окна
+//   --profile [файл.csv]                 - замер времени этапов кадра (можно добавить к любому режиму)
+int main(int argc, char* argv[]) {
+	FrameProfiler::instance().configure(argc, argv);
+	std::string mode = argc > 1 ? argv[1] : "";
+	if (mode == "--generate") 
+	{
+		return generatePointFile(argc > 2 ? argv[2] : "L1_points.bin", argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 1000000);
+	}
+	if (mode == "--kernel-bench") 
+	{
+		return runKernelBenchmark(argc > 2 ? argv[2] : "");
+	}
+	std::string traceFile = argc > 2 ? argv[2] : "L1_input.trace";
+	std::string pointFile = (mode == "--load" && argc > 2) ? argv[2] : "L1_points.bin"; // файл для сохранения по клавише S
+	bool unthrottled = argc > 3 && std::string(argv[3]) == "--unthrottled";
+ 
+	std::unique_ptr<InputTraceWriter> recorder;
+	std::unique_ptr<InputTraceReader> player;
+	if (mode == "--record") 
+	{
+		recorder.reset(new InputTraceWriter(traceFile));
+		if (!recorder->isOpen()) 
+		{
+			std::cerr << "Cannot create " << traceFile << std::endl;
+			return 1;
+		}
+	}
+	else if (mode == "--replay") 
+	{
+		player.reset(new InputTraceReader(traceFile));
+		if (!player->isOpen()) 
+		{
+			std::cerr << "Cannot open " << traceFile << std::endl;
+			return 1;
+		}
+	}
+ 
 	// Создаем рабочее окно
 	sf::RenderWindow window(sf::VideoMode(800, 800), "Tochki");
-	window.setFramerateLimit(60);
+	window.setFramerateLimit(unthrottled ? 0 : 60);
  
-	// Вектор исходных контрольных точек
-	std::vector<ControlPoint> controlPoints = {
+	// Хранилище контрольных точек и сетка для поиска точки под курсором
+	ControlPointStore controlPoints;
+	PointGrid grid(GRID_CELL_SIZE);
+ 
+	// Перетаскиваемая точка (недействительная ссылка, если ничего не тащим)
+	PointHandle draggedPoint;
+ 
+	// Исходные контрольные точки
+	const ControlPoint initialPoints[] = {
 		{{100.0f, 100.0f}, {100.0f, 100.0f}, false, 0.0f},
 		{{200.0f, 200.0f}, {200.0f, 200.0f}, false, 1.0f},
 		{{300.0f, 300.0f}, {300.0f, 300.0f}, false, 2.0f},
 		{{400.0f, 400.0f}, {400.0f, 400.0f}, false, 3.0f},
 		{{500.0f, 500.0f}, {500.0f, 500.0f}, false, 4.0f}
 	};
+	if (mode == "--load") 
+	{
+		if (!loadControlPoints(pointFile, controlPoints, grid)) return 1;
+	}
+	else 
+	{
+		for (const auto& point : initialPoints)
+		{
+			addControlPoint(controlPoints, grid, point);
+		}
+	}
+ 
+	// Кривая через точки (режим переключается клавишей M)
+	CurveTessellator curve;
+ 
+	// Маркеры всех точек в одном буфере вершин
+	PointMarkerBatch markers(POINT_RADIUS, sf::Color::Red);
  
 	sf::Clock clock; // Часы для отслеживания времени
+	InputFrame input; // Ввод текущего кадра
+	std::vector<double> workTimes;      // Время работы кадров воспроизведения (без display) в миллисекундах
+	std::vector<double> frameIntervals; // Промежутки между началами кадров воспроизведения
+	std::chrono::steady_clock::time_point previousFrameStart;
  
 	// Основной цикл программы
 	while (window.isOpen())
 	{
-		sf::Event event;
+		auto frameStart = std::chrono::steady_clock::now();
+		if (player && !workTimes.empty()) 
+		{
+			frameIntervals.push_back(std::chrono::duration<double, std::milli>(frameStart - previousFrameStart).count());
+		}
+		previousFrameStart = frameStart;
+		PROFILE_BEGIN(inputTimer, "input");
+		sf::Event windowEvent;
+ 
+		if (player) 
+		{
+			// При воспроизведении окно только закрывается, остальной ввод берется из файла
+			while (window.pollEvent(windowEvent)) 
+			{
+				if (windowEvent.type == sf::Event::Closed)
+					window.close();
+			}
+			if (!player->read(input)) 
+			{
+				window.close();
+				break;
+			}
+		}
+		else 
+		{
+			// Есть ли новые события на окне
+			input.events.clear();
+			while (window.pollEvent(windowEvent)) 
+			{
+				input.events.push_back(windowEvent);
+			}
+			sf::Vector2i mousePos = sf::Mouse::getPosition(window);  // Позиция мыши в пикселях
+			input.cursor = sf::Vector2f(static_cast<float>(mousePos.x), static_cast<float>(mousePos.y));
+			input.time = clock.getElapsedTime().asSeconds() * MOVEMENT_SPEED;
+			if (recorder) recorder->write(input);
+		}
  
-		// Есть ли новые события на окне
-		while (window.pollEvent(event)) 
+		for (const sf::Event& event : input.events) 
 		{
 			if (event.type == sf::Event::Closed)
 				window.close();
@@ -66,19 +346,17 @@ int main() {
 				// Добавление новой точки при правом клике
 				if (event.mouseButton.button == sf::Mouse::Right) 
 				{
-					controlPoints.push_back({ mousePos, mousePos, false, static_cast<float>(controlPoints.size()) });
+					addControlPoint(controlPoints, grid, { mousePos, mousePos, false, static_cast<float>(controlPoints.size()) });
 				}
  
 				// Начало перетаскивания точки при левом клике
 				else if (event.mouseButton.button == sf::Mouse::Left) 
 				{
-					for (auto& point : controlPoints) 
+					PointHandle hovered = findHoveredPoint(controlPoints, grid, mousePos);
+					if (controlPoints.contains(hovered)) 
 					{
-						if (isPointHovered(mousePos, point.position)) 
-						{
-							point.isDragging = true;
-							break;
-						}
+						controlPoints.setDragging(hovered, true);
+						draggedPoint = hovered;
 					}
 				}
 			}
@@ -86,66 +364,75 @@ int main() {
 			if (event.type == sf::Event::MouseMoved) 
 			{
 				sf::Vector2f mousePos(event.mouseMove.x, event.mouseMove.y);
-				for (auto& point : controlPoints) 
+				if (controlPoints.contains(draggedPoint)) 
 				{
-					if (point.isDragging) 
-					{
-						// Обновляем позицию точки по движению мыши
-						point.position = mousePos;
-						point.startPosition = mousePos; // Также обновляем начальную позицию
-						break;
-					}
+					// Обновляем позицию точки по движению мыши (начальная позиция тоже обновляется)
+					controlPoints.moveTo(draggedPoint, mousePos);
+					grid.move(static_cast<int>(draggedPoint.index), mousePos.x, mousePos.y);
 				}
 			}
  
 			if (event.type == sf::Event::MouseButtonReleased && event.mouseButton.button == sf::Mouse::Left) 
 			{
-				for (auto& point : controlPoints) 
+				if (controlPoints.contains(draggedPoint)) 
 				{
-					point.isDragging = false;
+					controlPoints.setDragging(draggedPoint, false);
 				}
+				draggedPoint = PointHandle();
 			}
  
 			// Добавление новой точки при нажатии клавиши C
 			if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::C) 
 			{
-				// Получаем позицию мыши, где создадим новую точку
-				sf::Vector2i mousePos = sf::Mouse::getPosition(window);  // Позиция мыши в пикселях
-				sf::Vector2f mousePosF(static_cast<float>(mousePos.x), static_cast<float>(mousePos.y)); // Позиция в вещественных значениях
+				// Позиция мыши, где создадим новую точку
+				sf::Vector2f mousePosF = input.cursor;
+ 
+				// Добавляем новую точку в хранилище controlPoints
+				addControlPoint(controlPoints, grid, { mousePosF, mousePosF, false, static_cast<float>(controlPoints.size()) });
+			}
+ 
+			// Сохранение точек в файл при нажатии клавиши S
+			if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::S) 
+			{
+				if (savePoints(pointFile, controlPoints))
+					std::cout << "Saved " << controlPoints.size() << " points to " << pointFile << std::endl;
+				else
+					std::cerr << "Cannot write " << pointFile << std::endl;
+			}
  
-				// Добавляем новую точку в вектор controlPoints
-				controlPoints.push_back({ mousePosF, mousePosF, false, static_cast<float>(controlPoints.size()) });
+			// Переключение вида кривой при нажатии клавиши M: ломаная -> Катмулл-Ром -> Безье
+			if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::M) 
+			{
+				if (curve.getMode() == CurveMode::Polyline) curve.setMode(CurveMode::CatmullRom);
+				else if (curve.getMode() == CurveMode::CatmullRom) curve.setMode(CurveMode::Bezier);
+				else curve.setMode(CurveMode::Polyline);
 			}
  
 			// Удаление точки при нажатии клавиши D, если курсор находится над ней
 			if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::D) 
 			{
-				sf::Vector2i mousePos = sf::Mouse::getPosition(window);  // Получаем позицию мыши
-				sf::Vector2f mousePosF(static_cast<float>(mousePos.x), static_cast<float>(mousePos.y));
+				sf::Vector2f mousePosF = input.cursor;  // Позиция мыши
  
 				// Проверяем, находится ли курсор над какой-либо точкой, и удаляем эту точку
-				for (auto it = controlPoints.begin(); it != controlPoints.end(); ++it) 
+				// (ссылки на остальные точки не меняются, ссылка на удаленную перестает быть действительной)
+				PointHandle hovered = findHoveredPoint(controlPoints, grid, mousePosF);
+				if (controlPoints.contains(hovered)) 
 				{
-					if (isPointHovered(mousePosF, it->position)) 
-					{
-						controlPoints.erase(it);
-						break;
-					}
+					grid.remove(static_cast<int>(hovered.index));
+					controlPoints.remove(hovered);
 				}
 			}
 		}
  
+		inputTimer.stop();
+ 
 		// Обновляем позиции точек для анимации
-		float time = clock.getElapsedTime().asSeconds() * MOVEMENT_SPEED;
-		for (auto& point : controlPoints) 
-		{
-			if (!point.isDragging) 
-			{ // Только если точка не перетаскивается пользователем
-				updatePointPosition(point, time); // Комментируем, если хотим отключить анимацию
-			}
-		}
+		PROFILE_BEGIN(animateTimer, "animate");
+		updatePointPositions(controlPoints, input.time); // Комментируем, если хотим отключить анимацию
+		animateTimer.stop();
  
 		// Очищаем окно
+		PROFILE_BEGIN(curveTimer, "curve");
 		window.clear(sf::Color::White);
  
 		// Настройка 2D ортогональной проекции
@@ -155,27 +442,39 @@ int main() {
 		glMatrixMode(GL_MODELVIEW);
 		glLoadIdentity();
  
-		// Включаем OpenGL для рисования ломаной кривой
+		// Включаем OpenGL для рисования кривой (перестраиваются только сегменты со сдвинувшимися точками)
+		const std::vector<sf::Vector2f>& curvePoints = curve.update(controlPoints);
 		glBegin(GL_LINE_STRIP);
 		glColor3f(0.0f, 0.0f, 1.0f); // Синий цвет линии
-		for (const auto& point : controlPoints) 
+		for (const auto& point : curvePoints) 
 		{
-			glVertex2f(point.position.x, point.position.y);
+			glVertex2f(point.x, point.y);
 		}
 		glEnd();
- 
-		// Рисуем контрольные точки с помощью SFML
-		for (const auto& point : controlPoints) 
+		curveTimer.stop();
+ 
+		// Рисуем контрольные точки с помощью SFML: обновляем вершины сдвинувшихся точек и рисуем все одним вызовом
+		PROFILE_BEGIN(markersTimer, "markers");
+		markers.update(controlPoints);
+		markers.draw(window);
+		markersTimer.stop();
+		if (player) 
 		{
-			sf::CircleShape shape(POINT_RADIUS);
-			shape.setPosition(point.position.x - POINT_RADIUS, point.position.y - POINT_RADIUS);
-			shape.setFillColor(sf::Color::Red);
-			window.draw(shape);
+			workTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
 		}
  
 		// Отображаем содержимое окна
+		PROFILE_BEGIN(displayTimer, "display");
 		window.display();
+		displayTimer.stop();
+		FrameProfiler::instance().endFrame();
+	}
+ 
+	if (player) 
+	{
+		printFrameStats(workTimes, frameIntervals);
 	}
+	FrameProfiler::instance().finish();
  
 	return 0;
 }
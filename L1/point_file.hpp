@@ -0,0 +1,150 @@
+// сохранение и загрузка наборов контрольных точек в двоичном файле
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "control_points.hpp"
+
+// Файл целиком отображается в память только для чтения. Страницы подгружаются системой по мере обращения
+// и берутся прямо из файлового кеша, поэтому отдельный буфер под содержимое файла не нужен.
+class MappedFile
+{
+public:
+	explicit MappedFile(const std::string& fileName)
+	{
+#ifdef _WIN32
+		file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE) return;
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) return;
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr) return;
+		void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (view == nullptr) return;
+		bytes = static_cast<const unsigned char*>(view);
+		length = static_cast<size_t>(fileSize.QuadPart);
+#else
+		descriptor = open(fileName.c_str(), O_RDONLY);
+		if (descriptor < 0) return;
+		struct stat info;
+		if (fstat(descriptor, &info) != 0 || info.st_size == 0) return;
+		void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+		if (view == MAP_FAILED) return;
+		madvise(view, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL); // файл читается один раз подряд
+		bytes = static_cast<const unsigned char*>(view);
+		length = static_cast<size_t>(info.st_size);
+#endif
+	}
+
+	~MappedFile()
+	{
+#ifdef _WIN32
+		if (bytes != nullptr) UnmapViewOfFile(bytes);
+		if (mapping != nullptr) CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+		if (bytes != nullptr) munmap(const_cast<unsigned char*>(bytes), length);
+		if (descriptor >= 0) close(descriptor);
+#endif
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool isOpen() const { return bytes != nullptr; }
+	const unsigned char* data() const { return bytes; }
+	size_t size() const { return length; }
+
+private:
+	const unsigned char* bytes = nullptr;
+	size_t length = 0;
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#else
+	int descriptor = -1;
+#endif
+};
+
+// Формат файла: заголовок, затем три массива float по count значений - начальные x, начальные y и сдвиги фазы
+// в порядке кривой. Числа записаны в порядке байтов машины (little-endian на x86).
+struct PointFileHeader
+{
+	char magic[4];          // "L1PT"
+	std::uint32_t version;
+	std::uint64_t count;
+};
+
+const std::uint32_t POINT_FILE_VERSION = 1;
+
+// Запись массивов точек в файл
+inline bool writePointFile(const std::string& fileName, const float* x, const float* y, const float* angle, size_t count)
+{
+	std::ofstream file(fileName, std::ios::binary);
+	if (!file) return false;
+
+	PointFileHeader header;
+	std::memcpy(header.magic, "L1PT", 4);
+	header.version = POINT_FILE_VERSION;
+	header.count = count;
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(x), count * sizeof(float));
+	file.write(reinterpret_cast<const char*>(y), count * sizeof(float));
+	file.write(reinterpret_cast<const char*>(angle), count * sizeof(float));
+	return static_cast<bool>(file);
+}
+
+// Сохранение точек хранилища в порядке кривой (сохраняются начальные позиции, текущие восстановит анимация)
+inline bool savePoints(const std::string& fileName, const ControlPointStore& points)
+{
+	std::vector<float> x, y, angle;
+	x.reserve(points.size());
+	y.reserve(points.size());
+	angle.reserve(points.size());
+	for (PointHandle point = points.front(); points.contains(point); point = points.next(point))
+	{
+		sf::Vector2f start = points.startPosition(point);
+		x.push_back(start.x);
+		y.push_back(start.y);
+		angle.push_back(points.angleOffset(point));
+	}
+	return writePointFile(fileName, x.data(), y.data(), angle.data(), x.size());
+}
+
+// Загрузка точек из файла в конец кривой. Массивы копируются из отображенного файла прямо в хранилище,
+// без разбора каждой точки и без промежуточных буферов. Возвращает число загруженных точек, -1 при ошибке.
+inline long long loadPoints(const std::string& fileName, ControlPointStore& points)
+{
+	MappedFile file(fileName);
+	if (!file.isOpen() || file.size() < sizeof(PointFileHeader)) return -1;
+
+	PointFileHeader header;
+	std::memcpy(&header, file.data(), sizeof(header));
+	if (std::memcmp(header.magic, "L1PT", 4) != 0 || header.version != POINT_FILE_VERSION) return -1;
+	if (header.count > (file.size() - sizeof(header)) / (3 * sizeof(float))) return -1; // файл обрезан
+
+	size_t count = static_cast<size_t>(header.count);
+	const float* x = reinterpret_cast<const float*>(file.data() + sizeof(header));
+	points.append(x, x + count, x + 2 * count, count);
+	return static_cast<long long>(count);
+}
@@ -0,0 +1,140 @@
+// пространственный хеш для быстрого поиска точек рядом с курсором
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Равномерная сетка, ячейки которой хешируются в корзины.
+// Вставка, удаление и перемещение точки - O(1), запрос обходит 3x3 ячейки вокруг позиции,
+// поэтому его стоимость зависит только от плотности точек, а не от их общего количества.
+class PointGrid
+{
+public:
+	explicit PointGrid(float cellSize, size_t bucketCount = 1024)
+		: cellSize(cellSize), buckets(bucketCount)
+	{
+	}
+
+	void insert(int id, float x, float y)
+	{
+		if (id >= static_cast<int>(bucketOf.size()))
+		{
+			bucketOf.resize(id + 1, -1);
+			slotOf.resize(id + 1, -1);
+			cellX.resize(id + 1, 0);
+			cellY.resize(id + 1, 0);
+		}
+		// держим в среднем не больше двух точек на корзину
+		if (count + 1 > 2 * buckets.size()) rehash(buckets.size() * 2);
+
+		cellX[id] = cellCoord(x);
+		cellY[id] = cellCoord(y);
+		placeInBucket(id, bucketFor(cellX[id], cellY[id]));
+		++count;
+	}
+
+	// заранее готовим корзины под count точек, чтобы при массовой вставке не перестраивать их много раз
+	void reserve(size_t pointCount)
+	{
+		size_t bucketCount = buckets.size();
+		while (pointCount > 2 * bucketCount) bucketCount *= 2;
+		if (bucketCount != buckets.size()) rehash(bucketCount);
+	}
+
+	void remove(int id)
+	{
+		takeFromBucket(id);
+		--count;
+	}
+
+	// точка сдвинулась: перекладываем ее, только если сменилась ячейка
+	void move(int id, float x, float y)
+	{
+		std::int64_t cx = cellCoord(x);
+		std::int64_t cy = cellCoord(y);
+		if (cx == cellX[id] && cy == cellY[id]) return;
+		cellX[id] = cx;
+		cellY[id] = cy;
+
+		int bucket = bucketFor(cx, cy);
+		if (bucket == bucketOf[id]) return;
+		takeFromBucket(id);
+		placeInBucket(id, bucket);
+	}
+
+	// вызывает visit(id) для всех точек из ячеек 3x3 вокруг (x, y);
+	// из-за коллизий хеша могут попасться и точки из дальних ячеек, их отсеивает проверка расстояния
+	template <typename Visitor>
+	void query(float x, float y, Visitor visit) const
+	{
+		std::int64_t centerX = cellCoord(x);
+		std::int64_t centerY = cellCoord(y);
+		for (std::int64_t cy = centerY - 1; cy <= centerY + 1; ++cy)
+		{
+			for (std::int64_t cx = centerX - 1; cx <= centerX + 1; ++cx)
+			{
+				for (int id : buckets[bucketFor(cx, cy)])
+				{
+					visit(id);
+				}
+			}
+		}
+	}
+
+	size_t size() const { return count; }
+
+private:
+	std::int64_t cellCoord(float value) const
+	{
+		return static_cast<std::int64_t>(std::floor(value / cellSize));
+	}
+
+	int bucketFor(std::int64_t cx, std::int64_t cy) const
+	{
+		// хеш ячейки (Teschner et al.): координаты умножаются на большие простые числа
+		std::uint64_t hash = (static_cast<std::uint64_t>(cx) * 73856093u) ^ (static_cast<std::uint64_t>(cy) * 19349663u);
+		return static_cast<int>(hash % buckets.size());
+	}
+
+	void placeInBucket(int id, int bucket)
+	{
+		bucketOf[id] = bucket;
+		slotOf[id] = static_cast<int>(buckets[bucket].size());
+		buckets[bucket].push_back(id);
+	}
+
+	// удаление из корзины без сдвига: на место точки ставим последнюю
+	void takeFromBucket(int id)
+	{
+		std::vector<int>& bucket = buckets[bucketOf[id]];
+		int last = bucket.back();
+		bucket[slotOf[id]] = last;
+		slotOf[last] = slotOf[id];
+		bucket.pop_back();
+		bucketOf[id] = -1;
+		slotOf[id] = -1;
+	}
+
+	// увеличиваем число корзин и раскладываем точки заново по запомненным ячейкам
+	void rehash(size_t newBucketCount)
+	{
+		std::vector<std::vector<int>> oldBuckets(newBucketCount);
+		oldBuckets.swap(buckets);
+		for (const auto& bucket : oldBuckets)
+		{
+			for (int id : bucket)
+			{
+				placeInBucket(id, bucketFor(cellX[id], cellY[id]));
+			}
+		}
+	}
+
+	float cellSize;
+	std::vector<std::vector<int>> buckets;
+	std::vector<int> bucketOf;              // корзина точки по id (-1, если точки нет)
+	std::vector<int> slotOf;                // позиция точки внутри корзины
+	std::vector<std::int64_t> cellX, cellY; // ячейка точки
+	size_t count = 0;
+};
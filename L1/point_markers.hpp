@@ -0,0 +1,113 @@
+// отрисовка всех маркеров контрольных точек одним вызовом draw
+
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "control_points.hpp"
+
+// Каждая точка - текстурированный квадрат с кругом, квадраты всех точек лежат в одном буфере вершин.
+// Квадраты идут в том же порядке, что и плотные массивы хранилища, и рисуются только первые size() из них.
+// Переписываются только вершины сдвинувшихся точек, а на видеокарту отправляется только измененный диапазон.
+class PointMarkerBatch
+{
+public:
+	PointMarkerBatch(float radius, const sf::Color& color)
+		: color(color), buffer(sf::Quads, sf::VertexBuffer::Stream)
+	{
+		// круг рисуем в текстуру один раз, край сглаживаем по расстоянию до центра
+		unsigned size = static_cast<unsigned>(std::ceil(radius * 2.0f)) + 2;
+		sf::Image image;
+		image.create(size, size, sf::Color::Transparent);
+		float center = size / 2.0f;
+		for (unsigned y = 0; y < size; ++y)
+		{
+			for (unsigned x = 0; x < size; ++x)
+			{
+				float dx = x + 0.5f - center;
+				float dy = y + 0.5f - center;
+				float coverage = std::min(std::max(radius + 0.5f - std::sqrt(dx * dx + dy * dy), 0.0f), 1.0f);
+				image.setPixel(x, y, sf::Color(255, 255, 255, static_cast<sf::Uint8>(coverage * 255.0f)));
+			}
+		}
+		texture.loadFromImage(image);
+		texture.setSmooth(true);
+		textureSize = static_cast<float>(size);
+		useBuffer = sf::VertexBuffer::isAvailable();
+	}
+
+	// переписываем квадраты точек, которые сдвинулись или поменяли место в плотных массивах хранилища
+	void update(const ControlPointStore& points)
+	{
+		size_t count = points.size();
+		if (vertices.size() < count * 4)
+		{
+			// запас по емкости, чтобы не пересоздавать буфер на каждую новую точку
+			size_t oldSize = vertices.size();
+			vertices.resize(std::max(count * 4, oldSize * 2));
+			for (size_t i = oldSize; i < vertices.size(); i += 4)
+			{
+				for (int k = 0; k < 4; ++k) vertices[i + k].color = color;
+				vertices[i + 1].texCoords = sf::Vector2f(textureSize, 0.0f);
+				vertices[i + 2].texCoords = sf::Vector2f(textureSize, textureSize);
+				vertices[i + 3].texCoords = sf::Vector2f(0.0f, textureSize);
+			}
+			if (useBuffer) buffer.create(vertices.size());
+			markDirty(0, count * 4); // после create буфер пуст, загружаем все заново
+		}
+		quadCount = count;
+
+		float halfSize = textureSize / 2.0f;
+		for (size_t i = 0; i < count; ++i)
+		{
+			sf::Vertex* quad = &vertices[i * 4];
+			sf::Vector2f position = points.positionAt(i);
+			sf::Vector2f topLeft(position.x - halfSize, position.y - halfSize);
+			sf::Vector2f bottomRight(topLeft.x + textureSize, topLeft.y + textureSize);
+			if (quad[0].position == topLeft && quad[2].position == bottomRight) continue; // точка не двигалась
+
+			quad[0].position = topLeft;
+			quad[1].position = sf::Vector2f(bottomRight.x, topLeft.y);
+			quad[2].position = bottomRight;
+			quad[3].position = sf::Vector2f(topLeft.x, bottomRight.y);
+			markDirty(i * 4, i * 4 + 4);
+		}
+
+		if (useBuffer && dirtyBegin < dirtyEnd)
+		{
+			buffer.update(vertices.data() + dirtyBegin, dirtyEnd - dirtyBegin, static_cast<unsigned>(dirtyBegin));
+		}
+		dirtyBegin = vertices.size();
+		dirtyEnd = 0;
+	}
+
+	// все маркеры одним вызовом
+	void draw(sf::RenderTarget& target) const
+	{
+		if (quadCount == 0) return;
+		sf::RenderStates states;
+		states.texture = &texture;
+		if (useBuffer) target.draw(buffer, 0, quadCount * 4, states);
+		else target.draw(vertices.data(), quadCount * 4, sf::Quads, states);
+	}
+
+private:
+	void markDirty(size_t begin, size_t end)
+	{
+		dirtyBegin = std::min(dirtyBegin, begin);
+		dirtyEnd = std::max(dirtyEnd, end);
+	}
+
+	sf::Color color;
+	sf::Texture texture;
+	float textureSize = 0.0f;
+	std::vector<sf::Vertex> vertices; // копия буфера в памяти, 4 вершины на точку
+	sf::VertexBuffer buffer;          // буфер на видеокарте (если поддерживается, иначе рисуем из памяти)
+	bool useBuffer = false;
+	size_t quadCount = 0;             // сколько квадратов рисовать
+	size_t dirtyBegin = 0;            // диапазон вершин, которые нужно загрузить на видеокарту
+	size_t dirtyEnd = 0;
+};
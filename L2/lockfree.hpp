@@ -0,0 +1,81 @@
+// неблокирующие структуры для обмена данными между потоком симуляции и потоком рисования
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Тройной буфер: писатель заполняет свой буфер и публикует его одной атомарной заменой,
+// читатель забирает последний опубликованный. Никто никого не ждет, промежуточные состояния могут пропускаться.
+template <typename T>
+class TripleBuffer
+{
+public:
+	explicit TripleBuffer(const T& initial)
+		: buffers{ initial, initial, initial }
+	{
+	}
+
+	// буфер, который сейчас заполняет писатель
+	T& writeBuffer() { return buffers[writeIndex]; }
+
+	// публикуем заполненный буфер, взамен получаем свободный
+	void publish()
+	{
+		int previous = middle.exchange(writeIndex | FRESH_BIT, std::memory_order_acq_rel);
+		writeIndex = previous & INDEX_MASK;
+	}
+
+	// забираем последний опубликованный буфер; false, если нового с прошлого раза нет
+	bool acquire()
+	{
+		if ((middle.load(std::memory_order_relaxed) & FRESH_BIT) == 0) return false;
+		int previous = middle.exchange(readIndex, std::memory_order_acq_rel);
+		readIndex = previous & INDEX_MASK;
+		return true;
+	}
+
+	// буфер, который сейчас читает читатель
+	const T& readBuffer() const { return buffers[readIndex]; }
+
+private:
+	static constexpr int INDEX_MASK = 3;
+	static constexpr int FRESH_BIT = 4; // в среднем буфере лежат еще не прочитанные данные
+
+	T buffers[3];
+	int writeIndex = 0;             // принадлежит писателю
+	int readIndex = 1;              // принадлежит читателю
+	std::atomic<int> middle{ 2 };   // буфер, которым они обмениваются
+};
+
+// Очередь фиксированного размера для одного писателя и одного читателя
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+public:
+	// false, если очередь заполнена
+	bool push(const T& item)
+	{
+		size_t currentTail = tail.load(std::memory_order_relaxed);
+		size_t nextTail = (currentTail + 1) % Capacity;
+		if (nextTail == head.load(std::memory_order_acquire)) return false;
+		items[currentTail] = item;
+		tail.store(nextTail, std::memory_order_release);
+		return true;
+	}
+
+	// false, если очередь пуста
+	bool pop(T& item)
+	{
+		size_t currentHead = head.load(std::memory_order_relaxed);
+		if (currentHead == tail.load(std::memory_order_acquire)) return false;
+		item = items[currentHead];
+		head.store((currentHead + 1) % Capacity, std::memory_order_release);
+		return true;
+	}
+
+private:
+	T items[Capacity];
+	std::atomic<size_t> head{ 0 };
+	std::atomic<size_t> tail{ 0 };
+};
@@ -1,15 +1,32 @@
 // куб, пирамида, цилиндр (оно живое)
 
 #include <SFML/Graphics.hpp>
+#include <GL/glew.h>
 #include <SFML/OpenGL.hpp>
 #include <GL/glu.h>
+#include <chrono>
 #include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
 #include <vector>
-
-// Определение структуры 3D вектора
-struct Vector3 {
-	float x, y, z;
-};
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <random>
+#include <thread>
+#include <atomic>
+
+#include "lockfree.hpp"
+#include "picking.hpp"
+#include "rasterizer.hpp"
+#include "../common/headless.hpp"
+#include "../common/microbench.hpp"
+#include "../common/profiler.hpp"
+#include "../common/vector_math.hpp"
+
+// 3D вектор (общий для лабораторных, см. common/vector_math.hpp)
+using Vector3 = Vec3;
 
 // Точки схода
 Vector3 vanishingPointLeft = { -25.0f, 0.0f, -20.0f };
@@ -26,14 +43,16 @@ Vector3 cylinderOrigin = { 0.0f, 0.0f, 0.0f };  // Инициализация ц
 float cubeSize = 1.0f;
 float moveSpeed = 0.05f;
 
-// Переменная для отслеживания выбранного объекта
-int selectedObject = 3;
+const int WINDOW_WIDTH = 1600;
+const int WINDOW_HEIGHT = 1000;
 
-// Функция нормализации вектора
-Vector3 normalize(const Vector3& v) {
-	float length = std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
-	return { v.x / length, v.y / length, v.z / length };
-}
+// Камера
+Vector3 cameraEye = { 0.0f, 1.5f, 5.0f };
+Vector3 cameraTarget = { 0.0f, 0.0f, -5.0f };
+const float CAMERA_FOV = 45.0f; // поле зрения по вертикали в градусах
+
+// Индекс выбранного объекта в sceneObjects (-1, если ничего не выбрано)
+int selectedObject = 2;
 
 // ------------------------------------------------------------------------
 
@@ -42,8 +61,8 @@ std::vector<Vector3> calculateCylinderVertices(Vector3 origin, float radius, flo
 	std::vector<Vector3> vertices;
 
 	// Векторы к точкам схода от начальной точки
-	Vector3 toLeft = normalize({ vanishingPointLeft.x - origin.x, vanishingPointLeft.y - origin.y, vanishingPointLeft.z - origin.z });
-	Vector3 toRight = normalize({ vanishingPointRight.x - origin.x, vanishingPointRight.y - origin.y, vanishingPointRight.z - origin.z });
+	Vector3 toLeft = normalize(vanishingPointLeft - origin);
+	Vector3 toRight = normalize(vanishingPointRight - origin);
 
 	// Переменные для углов 
 	float angleStep = 2 * M_PI / segments;
@@ -70,39 +89,48 @@ std::vector<Vector3> calculateCylinderVertices(Vector3 origin, float radius, flo
 }
 
 
+// Вывод примитивов через OpenGL (аналогичный интерфейс у SoftwareRasterizer)
+struct GLRenderer {
+	void begin(GLenum mode) { glBegin(mode); }
+	void color(float r, float g, float b) { glColor3f(r, g, b); }
+	void vertex(float x, float y, float z) { glVertex3f(x, y, z); }
+	void end() { glEnd(); }
+};
+
 // Функция для рисования цилиндра 
-void drawCylinder(const std::vector<Vector3>& vertices, int segments) {
+template <typename Renderer>
+void drawCylinder(Renderer& renderer, const std::vector<Vector3>& vertices, int segments) {
 	// Рисуем нижнюю окружность (оранжевая)
-	glColor3f(1.0f, 0.5f, 0.0f); 
-	glBegin(GL_TRIANGLE_FAN);
-	glVertex3f(vertices[0].x, vertices[0].y, vertices[0].z); // Центр нижней окружности
+	renderer.color(1.0f, 0.5f, 0.0f); 
+	renderer.begin(GL_TRIANGLE_FAN);
+	renderer.vertex(vertices[0].x, vertices[0].y, vertices[0].z); // Центр нижней окружности
 	for (int i = 0; i < segments; ++i) {
-		glVertex3f(vertices[2 * i].x, vertices[2 * i].y, vertices[2 * i].z);  // Нижняя окружность
+		renderer.vertex(vertices[2 * i].x, vertices[2 * i].y, vertices[2 * i].z);  // Нижняя окружность
 	}
-	glEnd();
+	renderer.end();
 
 	// Рисуем верхнюю окружность (жёлтая)
-	glColor3f(1.0f, 1.0f, 0.0f); 
-	glBegin(GL_TRIANGLE_FAN);
-	glVertex3f(vertices[1].x, vertices[1].y, vertices[1].z); // Центр верхней окружности
+	renderer.color(1.0f, 1.0f, 0.0f); 
+	renderer.begin(GL_TRIANGLE_FAN);
+	renderer.vertex(vertices[1].x, vertices[1].y, vertices[1].z); // Центр верхней окружности
 	for (int i = 0; i < segments; ++i) {
-		glVertex3f(vertices[2 * i + 1].x, vertices[2 * i + 1].y, vertices[2 * i + 1].z);  // Верхняя окружность
+		renderer.vertex(vertices[2 * i + 1].x, vertices[2 * i + 1].y, vertices[2 * i + 1].z);  // Верхняя окружность
 	}
-	glEnd();
+	renderer.end();
 
 	// Рисуем боковую поверхность цилиндра (синий)
-	glColor3f(0.0f, 0.0f, 1.0f);  
-	glBegin(GL_QUADS);
+	renderer.color(0.0f, 0.0f, 1.0f);  
+	renderer.begin(GL_QUADS);
 	for (int i = 0; i < segments; ++i) {
 		int next = (i + 1) % segments;
 
 		// Боковые квадраты
-		glVertex3f(vertices[2 * i].x, vertices[2 * i].y, vertices[2 * i].z);  // Нижняя
-		glVertex3f(vertices[2 * next].x, vertices[2 * next].y, vertices[2 * next].z);  // Нижняя (следующая)
-		glVertex3f(vertices[2 * next + 1].x, vertices[2 * next + 1].y, vertices[2 * next + 1].z);  // Верхняя (следующая)
-		glVertex3f(vertices[2 * i + 1].x, vertices[2 * i + 1].y, vertices[2 * i + 1].z);  // Верхняя
+		renderer.vertex(vertices[2 * i].x, vertices[2 * i].y, vertices[2 * i].z);  // Нижняя
+		renderer.vertex(vertices[2 * next].x, vertices[2 * next].y, vertices[2 * next].z);  // Нижняя (следующая)
+		renderer.vertex(vertices[2 * next + 1].x, vertices[2 * next + 1].y, vertices[2 * next + 1].z);  // Верхняя (следующая)
+		renderer.vertex(vertices[2 * i + 1].x, vertices[2 * i + 1].y, vertices[2 * i + 1].z);  // Верхняя
 	}
-	glEnd();
+	renderer.end();
 }
 
 // Функция для вычисления вершин пирамиды 
@@ -110,20 +138,16 @@ std::vector<Vector3> calculatePyramidVertices(Vector3 origin, float baseSize, fl
 	std::vector<Vector3> vertices;
 
 	// Векторы к точкам схода от начальной точки
-	Vector3 toLeft = normalize({ vanishingPointLeft.x - origin.x, vanishingPointLeft.y - origin.y, vanishingPointLeft.z - origin.z });
-	Vector3 toRight = normalize({ vanishingPointRight.x - origin.x, vanishingPointRight.y - origin.y, vanishingPointRight.z - origin.z });
+	Vector3 toLeft = normalize(vanishingPointLeft - origin);
+	Vector3 toRight = normalize(vanishingPointRight - origin);
 
 	// Расчет вершин треугольного основания
-	Vector3 P0 = { origin.x, origin.y, origin.z }; // Вершина основания
-	Vector3 P1 = { origin.x + toLeft.x * baseSize, origin.y + toLeft.y * baseSize, origin.z + toLeft.z * baseSize }; // Вершина основания
-	Vector3 P2 = { origin.x + toRight.x * baseSize, origin.y + toRight.y * baseSize, origin.z + toRight.z * baseSize }; // Вершина основания
+	Vector3 P0 = origin; // Вершина основания
+	Vector3 P1 = origin + toLeft * baseSize; // Вершина основания
+	Vector3 P2 = origin + toRight * baseSize; // Вершина основания
 
 	// Находим центр треугольного основания
-	Vector3 centerBase = {
-		(P0.x + P1.x + P2.x) / 3.0f,
-		(P0.y + P1.y + P2.y) / 3.0f,
-		(P0.z + P1.z + P2.z) / 3.0f
-	};
+	Vector3 centerBase = (P0 + P1 + P2) / 3.0f;
 
 	// Верхняя точка относительно центра основания
 	Vector3 apex = { centerBase.x, centerBase.y + height, centerBase.z };
@@ -140,34 +164,35 @@ std::vector<Vector3> calculatePyramidVertices(Vector3 origin, float baseSize, fl
 
 
 // Функция для рисования пирамиды 
-void drawPyramid(const std::vector<Vector3>& vertices) {
-	glBegin(GL_TRIANGLES);
+template <typename Renderer>
+void drawPyramid(Renderer& renderer, const std::vector<Vector3>& vertices) {
+	renderer.begin(GL_TRIANGLES);
 
 	// Передняя грань - Красный
-	glColor3f(1.0f, 0.0f, 0.0f);
-	glVertex3f(vertices[0].x, vertices[0].y, vertices[0].z); // P0
-	glVertex3f(vertices[1].x, vertices[1].y, vertices[1].z); // P1
-	glVertex3f(vertices[3].x, vertices[3].y, vertices[3].z); // Apex
+	renderer.color(1.0f, 0.0f, 0.0f);
+	renderer.vertex(vertices[0].x, vertices[0].y, vertices[0].z); // P0
+	renderer.vertex(vertices[1].x, vertices[1].y, vertices[1].z); // P1
+	renderer.vertex(vertices[3].x, vertices[3].y, vertices[3].z); // Apex
 
 	// Левая грань - Зеленый
-	glColor3f(0.0f, 1.0f, 0.0f);
-	glVertex3f(vertices[1].x, vertices[1].y, vertices[1].z); // P1
-	glVertex3f(vertices[2].x, vertices[2].y, vertices[2].z); // P2
-	glVertex3f(vertices[3].x, vertices[3].y, vertices[3].z); // Apex
+	renderer.color(0.0f, 1.0f, 0.0f);
+	renderer.vertex(vertices[1].x, vertices[1].y, vertices[1].z); // P1
+	renderer.vertex(vertices[2].x, vertices[2].y, vertices[2].z); // P2
+	renderer.vertex(vertices[3].x, vertices[3].y, vertices[3].z); // Apex
 
 	// Правая грань - Синий
-	glColor3f(0.0f, 0.0f, 1.0f);
-	glVertex3f(vertices[2].x, vertices[2].y, vertices[2].z); // P2
-	glVertex3f(vertices[0].x, vertices[0].y, vertices[0].z); // P0
-	glVertex3f(vertices[3].x, vertices[3].y, vertices[3].z); // Apex
+	renderer.color(0.0f, 0.0f, 1.0f);
+	renderer.vertex(vertices[2].x, vertices[2].y, vertices[2].z); // P2
+	renderer.vertex(vertices[0].x, vertices[0].y, vertices[0].z); // P0
+	renderer.vertex(vertices[3].x, vertices[3].y, vertices[3].z); // Apex
 
 	// Основание пирамиды - Оранжевый 
-	glColor3f(1.0f, 0.5f, 0.0f);
-	glVertex3f(vertices[0].x, vertices[0].y, vertices[0].z); // P0
-	glVertex3f(vertices[1].x, vertices[1].y, vertices[1].z); // P1
-	glVertex3f(vertices[2].x, vertices[2].y, vertices[2].z); // P2
+	renderer.color(1.0f, 0.5f, 0.0f);
+	renderer.vertex(vertices[0].x, vertices[0].y, vertices[0].z); // P0
+	renderer.vertex(vertices[1].x, vertices[1].y, vertices[1].z); // P1
+	renderer.vertex(vertices[2].x, vertices[2].y, vertices[2].z); // P2
 
-	glEnd();
+	renderer.end();
 }
 
 
@@ -178,14 +203,14 @@ std::vector<Vector3> calculateCubeVertices(Vector3 origin, float size) {
 	std::vector<Vector3> vertices;
 
 	// Векторы к точкам схода от начальной точки
-	Vector3 toLeft = normalize({ vanishingPointLeft.x - origin.x, vanishingPointLeft.y - origin.y, vanishingPointLeft.z - origin.z });
-	Vector3 toRight = normalize({ vanishingPointRight.x - origin.x, vanishingPointRight.y - origin.y, vanishingPointRight.z - origin.z });
+	Vector3 toLeft = normalize(vanishingPointLeft - origin);
+	Vector3 toRight = normalize(vanishingPointRight - origin);
 
 	// Нижняя грань куба
 	Vector3 P0 = origin;
-	Vector3 P1 = { origin.x + toLeft.x * size, origin.y + toLeft.y * size, origin.z + toLeft.z * size };
-	Vector3 P2 = { origin.x + toRight.x * size, origin.y + toRight.y * size, origin.z + toRight.z * size };
-	Vector3 P3 = { P1.x + toRight.x * size, P1.y + toRight.y * size, P1.z + toRight.z * size };
+	Vector3 P1 = origin + toLeft * size;
+	Vector3 P2 = origin + toRight * size;
+	Vector3 P3 = P1 + toRight * size;
 
 	// Высота куба
 	float height = size;
@@ -221,52 +246,53 @@ std::vector<Vector3> calculateCubeVertices(Vector3 origin, float size) {
 
 
 // Функция для рисования куба 
-void drawCube(const std::vector<Vector3>& vertices) {
-	glBegin(GL_QUADS);
+template <typename Renderer>
+void drawCube(Renderer& renderer, const std::vector<Vector3>& vertices) {
+	renderer.begin(GL_QUADS);
 
 	// Нижняя грань - Красный
-	glColor3f(1.0f, 0.0f, 0.0f);
-	glVertex3f(vertices[0].x, vertices[0].y, vertices[0].z);
-	glVertex3f(vertices[1].x, vertices[1].y, vertices[1].z);
-	glVertex3f(vertices[3].x, vertices[3].y, vertices[3].z);
-	glVertex3f(vertices[2].x, vertices[2].y, vertices[2].z);
+	renderer.color(1.0f, 0.0f, 0.0f);
+	renderer.vertex(vertices[0].x, vertices[0].y, vertices[0].z);
+	renderer.vertex(vertices[1].x, vertices[1].y, vertices[1].z);
+	renderer.vertex(vertices[3].x, vertices[3].y, vertices[3].z);
+	renderer.vertex(vertices[2].x, vertices[2].y, vertices[2].z);
 
 	// Верхняя грань - Зеленый
-	glColor3f(0.0f, 1.0f, 0.0f);
-	glVertex3f(vertices[4].x, vertices[4].y, vertices[4].z);
-	glVertex3f(vertices[5].x, vertices[5].y, vertices[5].z);
-	glVertex3f(vertices[7].x, vertices[7].y, vertices[7].z);
-	glVertex3f(vertices[6].x, vertices[6].y, vertices[6].z);
+	renderer.color(0.0f, 1.0f, 0.0f);
+	renderer.vertex(vertices[4].x, vertices[4].y, vertices[4].z);
+	renderer.vertex(vertices[5].x, vertices[5].y, vertices[5].z);
+	renderer.vertex(vertices[7].x, vertices[7].y, vertices[7].z);
+	renderer.vertex(vertices[6].x, vertices[6].y, vertices[6].z);
 
 	// Передняя грань - Синий
-	glColor3f(0.0f, 0.0f, 1.0f);
-	glVertex3f(vertices[0].x, vertices[0].y, vertices[0].z);
-	glVertex3f(vertices[1].x, vertices[1].y, vertices[1].z);
-	glVertex3f(vertices[5].x, vertices[5].y, vertices[5].z);
-	glVertex3f(vertices[4].x, vertices[4].y, vertices[4].z);
+	renderer.color(0.0f, 0.0f, 1.0f);
+	renderer.vertex(vertices[0].x, vertices[0].y, vertices[0].z);
+	renderer.vertex(vertices[1].x, vertices[1].y, vertices[1].z);
+	renderer.vertex(vertices[5].x, vertices[5].y, vertices[5].z);
+	renderer.vertex(vertices[4].x, vertices[4].y, vertices[4].z);
 
 	// Задняя грань - Желтый
-	glColor3f(1.0f, 1.0f, 0.0f);
-	glVertex3f(vertices[2].x, vertices[2].y, vertices[2].z);
-	glVertex3f(vertices[3].x, vertices[3].y, vertices[3].z);
-	glVertex3f(vertices[7].x, vertices[7].y, vertices[7].z);
-	glVertex3f(vertices[6].x, vertices[6].y, vertices[6].z);
+	renderer.color(1.0f, 1.0f, 0.0f);
+	renderer.vertex(vertices[2].x, vertices[2].y, vertices[2].z);
+	renderer.vertex(vertices[3].x, vertices[3].y, vertices[3].z);
+	renderer.vertex(vertices[7].x, vertices[7].y, vertices[7].z);
+	renderer.vertex(vertices[6].x, vertices[6].y, vertices[6].z);
 
 	// Левая грань - Оранжевый
-	glColor3f(1.0f, 0.5f, 0.0f);
-	glVertex3f(vertices[0].x, vertices[0].y, vertices[0].z);
-	glVertex3f(vertices[4].x, vertices[4].y, vertices[4].z);
-	glVertex3f(vertices[6].x, vertices[6].y, vertices[6].z);
-	glVertex3f(vertices[2].x, vertices[2].y, vertices[2].z);
+	renderer.color(1.0f, 0.5f, 0.0f);
+	renderer.vertex(vertices[0].x, vertices[0].y, vertices[0].z);
+	renderer.vertex(vertices[4].x, vertices[4].y, vertices[4].z);
+	renderer.vertex(vertices[6].x, vertices[6].y, vertices[6].z);
+	renderer.vertex(vertices[2].x, vertices[2].y, vertices[2].z);
 
 	// Правая грань - Фиолетовый
-	glColor3f(0.5f, 0.0f, 1.0f);
-	glVertex3f(vertices[1].x, vertices[1].y, vertices[1].z);
-	glVertex3f(vertices[5].x, vertices[5].y, vertices[5].z);
-	glVertex3f(vertices[7].x, vertices[7].y, vertices[7].z);
-	glVertex3f(vertices[3].x, vertices[3].y, vertices[3].z);
+	renderer.color(0.5f, 0.0f, 1.0f);
+	renderer.vertex(vertices[1].x, vertices[1].y, vertices[1].z);
+	renderer.vertex(vertices[5].x, vertices[5].y, vertices[5].z);
+	renderer.vertex(vertices[7].x, vertices[7].y, vertices[7].z);
+	renderer.vertex(vertices[3].x, vertices[3].y, vertices[3].z);
 
-	glEnd();
+	renderer.end();
 }
 
 // ------------------------------------------------------------------------
@@ -277,30 +303,120 @@ void drawCube(const std::vector<Vector3>& vertices) {
 
 
 
-// Функция обработки ввода для перемещения выбранного объекта
-void handleInput() {
-	Vector3* selectedObjectPosition = nullptr;
+// Объект сцены, который можно выбрать и перемещать
+struct SceneObject {
+	const char* name;
+	Vector3* position;                            // точка привязки, которую двигает пользователь
+	std::function<std::vector<Vector3>()> points; // точки, по которым строятся границы для выбора мышью
+	bool dependsOnVanishingPoints = false;        // фигура строится по точкам схода и сдвигается вместе с ними
+};
 
-	// Логика выбора объекта для управления
-	if (selectedObject == 1) {
-		selectedObjectPosition = &vanishingPointLeft;  // Левая точка схода
+// Точка схода выбирается по небольшому кубу вокруг нее
+std::vector<Vector3> vanishingPointMarker(const Vector3& point) {
+	const float halfSize = 0.5f;
+	return { { point.x - halfSize, point.y - halfSize, point.z - halfSize }, { point.x + halfSize, point.y + halfSize, point.z + halfSize } };
+}
+
+std::vector<SceneObject> sceneObjects = {
+	{ "Left vanishing point", &vanishingPointLeft, [] { return vanishingPointMarker(vanishingPointLeft); } },
+	{ "Right vanishing point", &vanishingPointRight, [] { return vanishingPointMarker(vanishingPointRight); } },
+	{ "Cube", &cubeOrigin, [] { return calculateCubeVertices(cubeOrigin, cubeSize); }, true },
+	{ "Pyramid", &pyramidOrigin, [] { return calculatePyramidVertices(pyramidOrigin, cubeSize, 1.0f); }, true },
+	{ "Cylinder", &cylinderOrigin, [] { return calculateCylinderVertices(cylinderOrigin, 0.5f, cubeSize * 0.9f, 20); }, true },
+};
+
+// Объекты, сдвинутые после последнего выбора мышью: перед выбором пересчитываются границы только у них.
+// Оба списка принадлежат потоку симуляции (там и ввод, и выбор)
+std::vector<int> movedObjects;
+std::vector<char> objectMoved; // флаг, чтобы объект попадал в список один раз
+
+// Отмечаем сдвинутый объект; вместе с точкой схода сдвигаются все фигуры, построенные по ней
+void markObjectMoved(int object) {
+	objectMoved.resize(sceneObjects.size(), 0);
+	auto mark = [](int i) {
+		if (!objectMoved[i]) {
+			objectMoved[i] = 1;
+			movedObjects.push_back(i);
+		}
+	};
+	mark(object);
+	const Vector3* position = sceneObjects[object].position;
+	if (position == &vanishingPointLeft || position == &vanishingPointRight) {
+		for (size_t i = 0; i < sceneObjects.size(); ++i) {
+			if (sceneObjects[i].dependsOnVanishingPoints) mark(static_cast<int>(i));
+		}
 	}
-	else if (selectedObject == 2) {
-		selectedObjectPosition = &vanishingPointRight;  // Правая точка схода
+}
+
+// Ограничивающий параллелепипед по набору точек
+PickBounds calculateBounds(const std::vector<Vector3>& points) {
+	PickBounds bounds = { { points[0].x, points[0].y, points[0].z }, { points[0].x, points[0].y, points[0].z } };
+	for (const Vector3& point : points) {
+		const float coords[3] = { point.x, point.y, point.z };
+		for (int axis = 0; axis < 3; ++axis) {
+			bounds.min[axis] = std::min(bounds.min[axis], coords[axis]);
+			bounds.max[axis] = std::max(bounds.max[axis], coords[axis]);
+		}
 	}
-	else if (selectedObject == 3) {
-		selectedObjectPosition = &cubeOrigin;  // Куб
+	return bounds;
+}
+
+// Строим индекс для выбора мышью по текущим положениям объектов
+void buildPickingIndex(BoundingVolumeHierarchy& index) {
+	std::vector<PickBounds> bounds;
+	bounds.reserve(sceneObjects.size());
+	for (const SceneObject& object : sceneObjects) {
+		bounds.push_back(calculateBounds(object.points()));
 	}
-	else if (selectedObject == 4) {
-		selectedObjectPosition = &pyramidOrigin;  // Пирамида
+	index.build(bounds);
+	movedObjects.clear();
+	objectMoved.assign(sceneObjects.size(), 0);
+}
+
+// Луч из камеры через пиксель экрана (та же камера, что в gluPerspective/gluLookAt)
+void calculatePickRay(int mouseX, int mouseY, float width, float height, float origin[3], float direction[3]) {
+	Vector3 forward = normalize(cameraTarget - cameraEye);
+	Vector3 right = normalize({ -forward.z, 0.0f, forward.x }); // forward x (0, 1, 0)
+	Vector3 up = cross(right, forward);
+
+	float tanHalfFov = std::tan(CAMERA_FOV * M_PI / 360.0f);
+	float px = (2.0f * (mouseX + 0.5f) / width - 1.0f) * tanHalfFov * (width / height);
+	float py = (1.0f - 2.0f * (mouseY + 0.5f) / height) * tanHalfFov;
+
+	Vector3 ray = normalize(forward + right * px + up * py);
+	origin[0] = cameraEye.x; origin[1] = cameraEye.y; origin[2] = cameraEye.z;
+	direction[0] = ray.x; direction[1] = ray.y; direction[2] = ray.z;
+}
+
+// Выбор объекта мышью: возвращает индекс объекта под курсором или -1
+int pickObject(BoundingVolumeHierarchy& index, int mouseX, int mouseY, float width, float height) {
+	// Обновляем границы только сдвинутых объектов (каждый - O(log n) по пути от листа к корню)
+	for (int object : movedObjects) {
+		index.update(object, calculateBounds(sceneObjects[object].points()));
+		objectMoved[object] = 0;
 	}
-	else if (selectedObject == 5) {
-		selectedObjectPosition = &cylinderOrigin;  // Цилиндр
+	movedObjects.clear();
+
+	float origin[3], direction[3];
+	calculatePickRay(mouseX, mouseY, width, height, origin, direction);
+	float t;
+	return index.raycast(origin, direction, t);
+}
+
+// Функция обработки ввода для перемещения выбранного объекта
+void handleInput() {
+	Vector3* selectedObjectPosition = nullptr;
+
+	// Логика выбора объекта для управления
+	if (selectedObject >= 0 && selectedObject < static_cast<int>(sceneObjects.size())) {
+		selectedObjectPosition = sceneObjects[selectedObject].position;
 	}
 
 	// Если объект выбран, обрабатываем его движение
 	if (selectedObjectPosition != nullptr) 
 	{
+		Vector3 previousPosition = *selectedObjectPosition;
+
 		// Обработка ввода для объектов
 		if (sf::Keyboard::isKeyPressed(sf::Keyboard::W)) {
 			selectedObjectPosition->z -= moveSpeed;
@@ -320,42 +436,327 @@ void handleInput() {
 		if (sf::Keyboard::isKeyPressed(sf::Keyboard::E)) {
 			selectedObjectPosition->y -= moveSpeed;
 		}
-	}
 
-	// Переключение между объектами
-	if (sf::Keyboard::isKeyPressed(sf::Keyboard::Num1)) {
-		selectedObject = 1;  // Выбираем левую точку схода
+		// Границы для выбора мышью пересчитаем при следующем щелчке
+		if (selectedObjectPosition->x != previousPosition.x || selectedObjectPosition->y != previousPosition.y || selectedObjectPosition->z != previousPosition.z) {
+			markObjectMoved(selectedObject);
+		}
 	}
-	else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Num2)) {
-		selectedObject = 2;  // Выбираем правую точку схода
+
+	// Быстрое переключение клавишами 1-5 (мышью выбирается любой объект)
+	const sf::Keyboard::Key selectKeys[] = { sf::Keyboard::Num1, sf::Keyboard::Num2, sf::Keyboard::Num3, sf::Keyboard::Num4, sf::Keyboard::Num5 };
+	for (int i = 0; i < 5 && i < static_cast<int>(sceneObjects.size()); ++i) {
+		if (sf::Keyboard::isKeyPressed(selectKeys[i])) {
+			selectedObject = i;
+			break;
+		}
 	}
-	else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Num3)) {
-		selectedObject = 3;  // Выбираем куб
+}
+
+// Замер скорости выбора мышью на большом числе случайных объектов: к объектам сцены добавляются кубики,
+// перед каждым щелчком один из них сдвигается (как при перетаскивании), замеряется весь pickObject
+int runPickingBenchmark(int objectCount) {
+	std::mt19937 gen(12345); // фиксированное зерно, чтобы запуски были сравнимы
+	std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+	std::uniform_real_distribution<float> size(0.1f, 1.0f);
+
+	// положения хранятся отдельно и не перемещаются в памяти: на них указывают объекты сцены
+	std::vector<Vector3> boxOrigins(objectCount);
+	std::vector<float> boxSizes(objectCount);
+	sceneObjects.reserve(sceneObjects.size() + objectCount);
+	for (int i = 0; i < objectCount; ++i) {
+		boxOrigins[i] = { position(gen), position(gen), position(gen) };
+		boxSizes[i] = size(gen);
+		sceneObjects.push_back({ "Box", &boxOrigins[i], [&boxOrigins, &boxSizes, i] {
+			return std::vector<Vector3>{ boxOrigins[i], boxOrigins[i] + Vector3(boxSizes[i], boxSizes[i], boxSizes[i]) };
+		} });
 	}
-	else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Num4)) {
-		selectedObject = 4;  // Выбираем пирамиду
+	int firstBox = static_cast<int>(sceneObjects.size()) - objectCount;
+
+	BoundingVolumeHierarchy index;
+	auto buildStart = std::chrono::steady_clock::now();
+	buildPickingIndex(index);
+	auto buildFinish = std::chrono::steady_clock::now();
+
+	const int pickCount = 10000;
+	std::uniform_int_distribution<int> pixelX(0, WINDOW_WIDTH - 1);
+	std::uniform_int_distribution<int> pixelY(0, WINDOW_HEIGHT - 1);
+	std::uniform_int_distribution<int> movedBox(0, objectCount - 1);
+	int hits = 0;
+	double totalPick = 0.0, worstPick = 0.0;
+	for (int i = 0; i < pickCount; ++i) {
+		int box = movedBox(gen);
+		boxOrigins[box].x += moveSpeed;
+		markObjectMoved(firstBox + box);
+		int mouseX = pixelX(gen), mouseY = pixelY(gen);
+
+		auto start = std::chrono::steady_clock::now();
+		if (pickObject(index, mouseX, mouseY, (float)WINDOW_WIDTH, (float)WINDOW_HEIGHT) >= 0) ++hits;
+		double pick = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+		totalPick += pick;
+		worstPick = std::max(worstPick, pick);
 	}
-	else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Num5)) {
-		selectedObject = 5;  // Выбираем цилиндр
+	sceneObjects.resize(firstBox);
+
+	std::cout << "Objects: " << index.size() << ", build: " << std::chrono::duration<double, std::milli>(buildFinish - buildStart).count() << " ms" << std::endl;
+	std::cout << "Picks: " << pickCount << " (one object moved before each), hits: " << hits
+		<< ", avg: " << totalPick / pickCount << " us"
+		<< ", worst: " << worstPick << " us" << std::endl;
+	return 0;
+}
+
+// Замер расчета вершин каждой фигуры по отдельности на случайных точках отсчета (зерно фиксированное).
+// Вектор вершин создается при каждом вызове, как в снимке сцены, поэтому выделение памяти входит в замер
+int runKernelBenchmark(const std::string& filter) {
+	const size_t INPUTS = 1024; // степень двойки: номер входа - i & (INPUTS - 1)
+	std::mt19937 gen(12345);
+	std::uniform_real_distribution<float> position(-5.0f, 5.0f);
+	std::vector<Vector3> origins(INPUTS);
+	for (Vector3& origin : origins) {
+		origin = Vector3(position(gen), position(gen), position(gen));
 	}
+
+	MicroBenchmark bench(filter);
+	bench.run("calculateCubeVertices", [&](size_t i) {
+		keepResult(calculateCubeVertices(origins[i & (INPUTS - 1)], cubeSize).data());
+	}, static_cast<double>(calculateCubeVertices(origins[0], cubeSize).size()));
+	bench.run("calculatePyramidVertices", [&](size_t i) {
+		keepResult(calculatePyramidVertices(origins[i & (INPUTS - 1)], cubeSize, 1.0f).data());
+	}, static_cast<double>(calculatePyramidVertices(origins[0], cubeSize, 1.0f).size()));
+	bench.run("calculateCylinderVertices (20 segments)", [&](size_t i) {
+		keepResult(calculateCylinderVertices(origins[i & (INPUTS - 1)], 0.5f, cubeSize * 0.9f, 20).data());
+	}, static_cast<double>(calculateCylinderVertices(origins[0], 0.5f, cubeSize * 0.9f, 20).size()));
+	return 0;
 }
 
+// Вершины фигур на один шаг симуляции. Поток симуляции заполняет снимок, поток рисования только читает его
+struct SceneSnapshot {
+	std::vector<Vector3> cubeVertices;
+	std::vector<Vector3> pyramidVertices;
+	std::vector<Vector3> cylinderVertices;
+};
 
+// Пересчитываем вершины фигур по текущим положениям
+void calculateSnapshot(SceneSnapshot& snapshot) {
+	// Пересчитываем вершины куба
+	snapshot.cubeVertices = calculateCubeVertices(cubeOrigin, cubeSize);
+	// Пересчитываем вершины пирамиды
+	snapshot.pyramidVertices = calculatePyramidVertices(pyramidOrigin, cubeSize, 1.0f);
+	// Пересчитываем вершины цилиндра
+	snapshot.cylinderVertices = calculateCylinderVertices(cylinderOrigin, 0.5f, cubeSize * 0.9f, 20); // 20 сегментов
+}
 
+// Рисуем фигуры снимка через выбранный способ вывода
+template <typename Renderer>
+void drawScene(Renderer& renderer, const SceneSnapshot& snapshot) {
+	// Рисуем куб
+	drawCube(renderer, snapshot.cubeVertices);
+	// Рисуем пирамиду
+	drawPyramid(renderer, snapshot.pyramidVertices);
+	// Рисуем цилиндр
+	drawCylinder(renderer, snapshot.cylinderVertices, 20);  // 20 сегментов цилиндра
+
+	// Рисуем линии схода
+	// drawVanishingLines(snapshot.cubeVertices);
+}
 
-int main() 
-{
-	sf::RenderWindow window(sf::VideoMode(1600, 1000), "KUB PIRAMIDA I CCILINDR", sf::Style::Default, sf::ContextSettings(24));
-	window.setFramerateLimit(60);
+// Щелчок мыши, переданный из потока окна в поток симуляции
+struct PickRequest {
+	int mouseX, mouseY;
+	float width, height;
+};
+
+const int SIMULATION_RATE = 60; // шагов симуляции в секунду (moveSpeed задана на один шаг)
+
+// Поток симуляции: ввод, выбор мышью и пересчет вершин. Результат публикуется через тройной буфер
+void runSimulation(TripleBuffer<SceneSnapshot>& snapshots, SpscQueue<PickRequest, 64>& pickRequests, const std::atomic<bool>& running) {
+	// Индекс для выбора объектов мышью принадлежит потоку симуляции
+	BoundingVolumeHierarchy pickingIndex;
+	buildPickingIndex(pickingIndex);
+
+	const auto step = std::chrono::microseconds(1000000 / SIMULATION_RATE);
+	auto nextStep = std::chrono::steady_clock::now();
+	while (running.load(std::memory_order_relaxed)) {
+		PROFILE_BEGIN(simulateTimer, "simulate");
+
+		// Выбор объекта левой кнопкой мыши
+		PickRequest request;
+		while (pickRequests.pop(request)) {
+			int picked = pickObject(pickingIndex, request.mouseX, request.mouseY, request.width, request.height);
+			if (picked >= 0) {
+				selectedObject = picked;
+				std::cout << "Selected: " << sceneObjects[picked].name << std::endl;
+			}
+		}
 
+		// Обработка ввода
+		handleInput();
+
+		calculateSnapshot(snapshots.writeBuffer());
+		snapshots.publish();
+		simulateTimer.stop();
+
+		nextStep += step;
+		std::this_thread::sleep_until(nextStep);
+	}
+}
+
+// Кадр программным растеризатором с той же камерой, что и в OpenGL
+void renderSoftwareFrame(SoftwareRasterizer& rasterizer, const SceneSnapshot& snapshot) {
+	rasterizer.clear(1.0f, 1.0f, 1.0f);
+	rasterizer.setPerspective(CAMERA_FOV, rasterizer.width() / (float)rasterizer.height(), 1.0f, 100.0f);
+	rasterizer.lookAt(cameraEye.x, cameraEye.y, cameraEye.z, cameraTarget.x, cameraTarget.y, cameraTarget.z, 0.0f, 1.0f, 0.0f);
+	drawScene(rasterizer, snapshot);
+	rasterizer.flush();
+}
+
+// Проекция для рисования через OpenGL (один раз, камера задается в каждом кадре)
+void setupOpenGLProjection(float aspect) {
 	glEnable(GL_DEPTH_TEST);
 	glMatrixMode(GL_PROJECTION);
 	glLoadIdentity();
-	gluPerspective(45.0f, window.getSize().x / (float)window.getSize().y, 1.0f, 100.0f);
+	gluPerspective(CAMERA_FOV, aspect, 1.0f, 100.0f);
 	glMatrixMode(GL_MODELVIEW);
+}
+
+// Кадр через OpenGL
+void renderOpenGLFrame(GLRenderer& renderer, const SceneSnapshot& snapshot) {
+	// Очищаем буфер
+	glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glLoadIdentity();
+
+	// Камера
+	gluLookAt(cameraEye.x, cameraEye.y, cameraEye.z, cameraTarget.x, cameraTarget.y, cameraTarget.z, 0.0f, 1.0f, 0.0f);
+
+	drawScene(renderer, snapshot);
+}
+
+// Замер времени кадров программного растеризатора без окна, последний кадр сохраняется в файл
+int runSoftwareBenchmark(int frames, const std::string& outputFile) {
+	SoftwareRasterizer rasterizer(WINDOW_WIDTH, WINDOW_HEIGHT);
+	SceneSnapshot snapshot;
+	std::vector<double> frameTimes;
+
+	for (int i = 0; i < frames; ++i) {
+		auto start = std::chrono::steady_clock::now();
+		{
+			PROFILE_SCOPE("geometry");
+			calculateSnapshot(snapshot);
+		}
+		{
+			PROFILE_SCOPE("rasterize");
+			renderSoftwareFrame(rasterizer, snapshot);
+		}
+		auto finish = std::chrono::steady_clock::now();
+		frameTimes.push_back(std::chrono::duration<double, std::milli>(finish - start).count());
+		FrameProfiler::instance().endFrame();
+	}
+	FrameProfiler::instance().finish();
+
+	if (!frameTimes.empty()) {
+		std::sort(frameTimes.begin(), frameTimes.end());
+		double total = 0.0;
+		for (double time : frameTimes) total += time;
+		std::cout << "Frames: " << frameTimes.size() << ", triangles per frame: " << rasterizer.triangleCount() << std::endl;
+		std::cout << "Frame time (ms): avg " << total / frameTimes.size()
+			<< ", min " << frameTimes.front()
+			<< ", median " << frameTimes[frameTimes.size() / 2]
+			<< ", max " << frameTimes.back() << std::endl;
+	}
+
+	sf::Image image;
+	image.create(rasterizer.width(), rasterizer.height(), rasterizer.pixels());
+	if (!image.saveToFile(outputFile)) {
+		return 1;
+	}
+	return 0;
+}
+
+// Рисование через OpenGL без окна (EGL, кадровый буфер): кадры подряд, снимок считается в том же потоке,
+// последний кадр сохраняется в файл. Параметры --headless [кадры] [файл.ppm] разбирает HeadlessRenderer
+int runHeadless(int argc, char* argv[]) {
+	HeadlessRenderer headless;
+	headless.configure(argc, argv, "L2_frame.ppm", 100);
+	if (!headless.create(WINDOW_WIDTH, WINDOW_HEIGHT)) {
+		return 1;
+	}
+	setupOpenGLProjection(WINDOW_WIDTH / (float)WINDOW_HEIGHT);
+
+	GLRenderer glRenderer;
+	SceneSnapshot snapshot;
+	while (headless.isOpen()) {
+		{
+			PROFILE_SCOPE("geometry");
+			calculateSnapshot(snapshot);
+		}
+		{
+			PROFILE_SCOPE("draw");
+			renderOpenGLFrame(glRenderer, snapshot);
+		}
+		headless.display();
+		FrameProfiler::instance().endFrame();
+	}
+	bool saved = headless.finish();
+	FrameProfiler::instance().finish();
+	return saved ? 0 : 1;
+}
+
+// Режимы запуска:
+//   без аргументов                      - рисование через OpenGL
+//   --software                          - программный растеризатор, кадр выводится в окно через sf::Texture
+//   --software-bench <кадры> <файл.png> - программный растеризатор без окна, замер времени кадров
+//   --headless <кадры> <файл.ppm>       - OpenGL без окна (EGL), замер времени кадров, последний кадр в файл
+//   --pick-bench <объекты>              - замер выбора мышью (pickObject) среди случайных объектов, которые сдвигаются
+//   --kernel-bench [фильтр]             - замер расчета вершин каждой фигуры по отдельности (только с фильтром в имени)
+//   --profile [файл.csv]                - замер времени этапов кадра (добавляется после остальных параметров)
+int main(int argc, char* argv[]) 
+{
+	FrameProfiler::instance().configure(argc, argv);
+	std::string mode = argc > 1 ? argv[1] : "";
+	if (mode == "--software-bench") {
+		int frames = argc > 2 ? std::atoi(argv[2]) : 100;
+		std::string outputFile = argc > 3 ? argv[3] : "L2_software.png";
+		return runSoftwareBenchmark(frames, outputFile);
+	}
+	if (mode == "--headless") {
+		return runHeadless(argc, argv);
+	}
+	if (mode == "--pick-bench") {
+		return runPickingBenchmark(std::max(1, argc > 2 ? std::atoi(argv[2]) : 100000));
+	}
+	if (mode == "--kernel-bench") {
+		return runKernelBenchmark(argc > 2 ? argv[2] : "");
+	}
+	bool software = (mode == "--software");
+
+	sf::RenderWindow window(sf::VideoMode(WINDOW_WIDTH, WINDOW_HEIGHT), "KUB PIRAMIDA I CCILINDR", sf::Style::Default, sf::ContextSettings(24));
+	window.setFramerateLimit(60);
+
+	GLRenderer glRenderer;
+	std::unique_ptr<SoftwareRasterizer> rasterizer;
+	sf::Texture frameTexture;
+	sf::Sprite frameSprite;
+	if (software) {
+		rasterizer.reset(new SoftwareRasterizer(WINDOW_WIDTH, WINDOW_HEIGHT));
+		frameTexture.create(WINDOW_WIDTH, WINDOW_HEIGHT);
+		frameSprite.setTexture(frameTexture);
+	}
+	else {
+		setupOpenGLProjection(window.getSize().x / (float)window.getSize().y);
+	}
+
+	// Запускаем поток симуляции, окно остается в главном потоке
+	SceneSnapshot initialSnapshot;
+	calculateSnapshot(initialSnapshot);
+	TripleBuffer<SceneSnapshot> snapshots(initialSnapshot);
+	SpscQueue<PickRequest, 64> pickRequests;
+	std::atomic<bool> running(true);
+	std::thread simulationThread(runSimulation, std::ref(snapshots), std::ref(pickRequests), std::cref(running));
 
 	while (window.isOpen()) 
 	{
+		PROFILE_BEGIN(inputTimer, "input");
 		sf::Event event;
 		while (window.pollEvent(event)) 
 		{
@@ -363,39 +764,43 @@ int main()
 			{
 				window.close();
 			}
-		}
-
-		// Обработка ввода
-		handleInput();
 
-		// Пересчитываем вершины куба
-		std::vector<Vector3> cubeVertices = calculateCubeVertices(cubeOrigin, cubeSize);
-		// Пересчитываем вершины пирамиды
-		std::vector<Vector3> pyramidVertices = calculatePyramidVertices(pyramidOrigin, cubeSize, 1.0f);
-		// Пересчитываем вершины цилиндра
-		std::vector<Vector3> cylinderVertices = calculateCylinderVertices(cylinderOrigin, 0.5f, cubeSize * 0.9f, 20); // 20 сегментов
-
-		// Очищаем буфер
-		glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		glLoadIdentity();
+			// Щелчок передаем потоку симуляции
+			if (event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == sf::Mouse::Left)
+			{
+				pickRequests.push({ event.mouseButton.x, event.mouseButton.y, (float)window.getSize().x, (float)window.getSize().y });
+			}
+		}
 
-		// Камера
-		gluLookAt(0.0f, 1.5f, 5.0f, 0.0f, 0.0f, -5.0f, 0.0f, 1.0f, 0.0f);
+		inputTimer.stop();
 
-		// Рисуем куб
-		drawCube(cubeVertices);
-		// Рисуем пирамиду
-		drawPyramid(pyramidVertices);
-		// Рисуем цилиндр
-		drawCylinder(cylinderVertices, 20);  // 20 сегментов цилиндра
+		// Берем последний опубликованный снимок (если нового нет, рисуем прежний)
+		snapshots.acquire();
+		const SceneSnapshot& snapshot = snapshots.readBuffer();
 
-		// Рисуем линии схода
-		// drawVanishingLines(cubeVertices);
+		PROFILE_BEGIN(drawTimer, "draw");
+		if (software) {
+			// Рисуем кадр на CPU и выводим его как текстуру
+			renderSoftwareFrame(*rasterizer, snapshot);
+			frameTexture.update(rasterizer->pixels());
+			window.clear();
+			window.draw(frameSprite);
+		}
+		else {
+			renderOpenGLFrame(glRenderer, snapshot);
+		}
+		drawTimer.stop();
 
+		PROFILE_BEGIN(displayTimer, "display");
 		window.display();
+		displayTimer.stop();
+		FrameProfiler::instance().endFrame();
 	}
 
+	running = false;
+	simulationThread.join();
+	FrameProfiler::instance().finish();
+
 	return 0;
 }
 
@@ -0,0 +1,228 @@
+// пространственный индекс (BVH) для выбора объектов лучом из камеры
+
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+// ограничивающий параллелепипед объекта, выровненный по осям
+struct PickBounds
+{
+	float min[3];
+	float max[3];
+};
+
+// Иерархия ограничивающих объемов над параллелепипедами объектов.
+// Строится один раз за O(n log n), при перемещении объекта обновляются только узлы на пути от его листа к корню.
+class BoundingVolumeHierarchy
+{
+public:
+	static constexpr int MAX_LEAF_SIZE = 4; // сколько объектов хранится в одном листе
+
+	void build(const std::vector<PickBounds>& bounds)
+	{
+		objectBounds = bounds;
+		nodes.clear();
+		objectOrder.resize(bounds.size());
+		objectLeaf.assign(bounds.size(), -1);
+		centroids.resize(bounds.size() * 3);
+		for (size_t i = 0; i < bounds.size(); ++i)
+		{
+			objectOrder[i] = static_cast<int>(i);
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				centroids[i * 3 + axis] = 0.5f * (bounds[i].min[axis] + bounds[i].max[axis]);
+			}
+		}
+		if (bounds.empty()) return;
+
+		nodes.reserve(2 * bounds.size() / MAX_LEAF_SIZE + 1);
+		nodes.push_back(Node());
+		buildNode(0, 0, static_cast<int>(bounds.size()), -1);
+	}
+
+	// объект переместился: меняем его границы и пересчитываем узлы до корня
+	void update(int object, const PickBounds& bounds)
+	{
+		objectBounds[object] = bounds;
+		int node = objectLeaf[object];
+		if (node < 0) return;
+
+		nodes[node].bounds = unionOfObjects(nodes[node].leftOrFirst, nodes[node].count);
+		for (node = nodes[node].parent; node >= 0; node = nodes[node].parent)
+		{
+			const Node& left = nodes[nodes[node].leftOrFirst];
+			const Node& right = nodes[nodes[node].leftOrFirst + 1];
+			nodes[node].bounds = unite(left.bounds, right.bounds);
+		}
+	}
+
+	// ближайший объект, чей параллелепипед пересекает луч; -1, если пересечений нет
+	int raycast(const float origin[3], const float direction[3], float& tHit) const
+	{
+		if (nodes.empty()) return -1;
+
+		float inverse[3];
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			inverse[axis] = 1.0f / direction[axis]; // деление на ноль дает бесконечность, тест слоев это учитывает
+		}
+
+		int hitObject = -1;
+		tHit = std::numeric_limits<float>::infinity();
+
+		int stack[64];
+		int stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize > 0)
+		{
+			const Node& node = nodes[stack[--stackSize]];
+			float tNode;
+			if (!intersect(node.bounds, origin, inverse, tNode) || tNode >= tHit) continue;
+
+			if (node.count > 0)
+			{
+				// лист: проверяем параллелепипеды объектов
+				for (int i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i)
+				{
+					float t;
+					if (intersect(objectBounds[objectOrder[i]], origin, inverse, t) && t < tHit)
+					{
+						tHit = t;
+						hitObject = objectOrder[i];
+					}
+				}
+				continue;
+			}
+
+			// сначала обходим ближний потомок, чтобы быстрее отсекать дальние узлы
+			int nearChild = node.leftOrFirst;
+			int farChild = node.leftOrFirst + 1;
+			float tNear, tFar;
+			bool hitNear = intersect(nodes[nearChild].bounds, origin, inverse, tNear);
+			bool hitFar = intersect(nodes[farChild].bounds, origin, inverse, tFar);
+			if (hitNear && hitFar)
+			{
+				if (tFar < tNear) std::swap(nearChild, farChild);
+				stack[stackSize++] = farChild;
+				stack[stackSize++] = nearChild;
+			}
+			else if (hitNear)
+			{
+				stack[stackSize++] = nearChild;
+			}
+			else if (hitFar)
+			{
+				stack[stackSize++] = farChild;
+			}
+		}
+		return hitObject;
+	}
+
+	size_t size() const { return objectBounds.size(); }
+
+private:
+	struct Node
+	{
+		PickBounds bounds;
+		int leftOrFirst = 0; // внутренний узел: индекс левого потомка (правый следом), лист: первый объект в objectOrder
+		int count = 0;       // количество объектов в листе, 0 у внутренних узлов
+		int parent = -1;
+	};
+
+	static PickBounds unite(const PickBounds& a, const PickBounds& b)
+	{
+		PickBounds result;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			result.min[axis] = std::min(a.min[axis], b.min[axis]);
+			result.max[axis] = std::max(a.max[axis], b.max[axis]);
+		}
+		return result;
+	}
+
+	PickBounds unionOfObjects(int first, int count) const
+	{
+		PickBounds result = objectBounds[objectOrder[first]];
+		for (int i = first + 1; i < first + count; ++i)
+		{
+			result = unite(result, objectBounds[objectOrder[i]]);
+		}
+		return result;
+	}
+
+	// тест слоев: расстояние входа луча в параллелепипед (0, если начало луча внутри)
+	static bool intersect(const PickBounds& bounds, const float origin[3], const float inverse[3], float& tEntry)
+	{
+		float tMin = 0.0f;
+		float tMax = std::numeric_limits<float>::infinity();
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			float t0 = (bounds.min[axis] - origin[axis]) * inverse[axis];
+			float t1 = (bounds.max[axis] - origin[axis]) * inverse[axis];
+			if (t0 > t1) std::swap(t0, t1);
+			tMin = t0 > tMin ? t0 : tMin; // такая запись отбрасывает NaN (0 * бесконечность)
+			tMax = t1 < tMax ? t1 : tMax;
+			if (tMin > tMax) return false;
+		}
+		tEntry = tMin;
+		return true;
+	}
+
+	// делим объекты пополам по самой длинной оси центров
+	void buildNode(int nodeIndex, int first, int count, int parent)
+	{
+		nodes[nodeIndex].parent = parent;
+		nodes[nodeIndex].bounds = unionOfObjects(first, count);
+
+		if (count <= MAX_LEAF_SIZE)
+		{
+			nodes[nodeIndex].leftOrFirst = first;
+			nodes[nodeIndex].count = count;
+			for (int i = first; i < first + count; ++i)
+			{
+				objectLeaf[objectOrder[i]] = nodeIndex;
+			}
+			return;
+		}
+
+		float centroidMin[3], centroidMax[3];
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			centroidMin[axis] = std::numeric_limits<float>::infinity();
+			centroidMax[axis] = -std::numeric_limits<float>::infinity();
+		}
+		for (int i = first; i < first + count; ++i)
+		{
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				centroidMin[axis] = std::min(centroidMin[axis], centroids[objectOrder[i] * 3 + axis]);
+				centroidMax[axis] = std::max(centroidMax[axis], centroids[objectOrder[i] * 3 + axis]);
+			}
+		}
+		int splitAxis = 0;
+		for (int axis = 1; axis < 3; ++axis)
+		{
+			if (centroidMax[axis] - centroidMin[axis] > centroidMax[splitAxis] - centroidMin[splitAxis]) splitAxis = axis;
+		}
+
+		int middle = first + count / 2;
+		std::nth_element(objectOrder.begin() + first, objectOrder.begin() + middle, objectOrder.begin() + first + count,
+			[&](int a, int b) { return centroids[a * 3 + splitAxis] < centroids[b * 3 + splitAxis]; });
+
+		int leftChild = static_cast<int>(nodes.size());
+		nodes.push_back(Node());
+		nodes.push_back(Node());
+		nodes[nodeIndex].leftOrFirst = leftChild;
+		nodes[nodeIndex].count = 0;
+		buildNode(leftChild, first, middle - first, nodeIndex);
+		buildNode(leftChild + 1, middle, first + count - middle, nodeIndex);
+	}
+
+	std::vector<Node> nodes;
+	std::vector<PickBounds> objectBounds;
+	std::vector<int> objectOrder;  // объекты, упорядоченные по листьям
+	std::vector<int> objectLeaf;   // лист, в котором лежит объект
+	std::vector<float> centroids;  // центры объектов, нужны только при построении
+};
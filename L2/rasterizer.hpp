@@ -0,0 +1,323 @@
+// программный растеризатор для сцен L2 (работает без GPU)
+
+#pragma once
+
+#include <SFML/OpenGL.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "../common/vector_math.hpp"
+#include "../common/worker_pool.hpp"
+
+// Растеризатор с интерфейсом, повторяющим glBegin/glColor3f/glVertex3f/glEnd.
+// Треугольники раскладываются по тайлам экрана, тайлы растеризуются параллельно.
+// Внутри тайла треугольники обрабатываются в порядке отправки, поэтому результат детерминирован.
+class SoftwareRasterizer
+{
+public:
+	static constexpr int TILE_SIZE = 64; // размер тайла в пикселях
+
+	SoftwareRasterizer(int width, int height, unsigned threadCount = std::thread::hardware_concurrency())
+		: frameWidth(width), frameHeight(height),
+		  tilesX((width + TILE_SIZE - 1) / TILE_SIZE), tilesY((height + TILE_SIZE - 1) / TILE_SIZE),
+		  colorBuffer(width * height), depthBuffer(width * height), tileBins(tilesX * tilesY),
+		  pool(std::max(1u, threadCount))
+	{
+	}
+
+	// аналог gluPerspective
+	void setPerspective(float fovyDegrees, float aspect, float zNear, float zFar)
+	{
+		projection = Mat4::perspective(fovyDegrees, aspect, zNear, zFar);
+		transform = projection * modelView;
+	}
+
+	// аналог glLoadIdentity + gluLookAt
+	void lookAt(float eyeX, float eyeY, float eyeZ, float centerX, float centerY, float centerZ, float upX, float upY, float upZ)
+	{
+		modelView = Mat4::lookAt(Vec3(eyeX, eyeY, eyeZ), Vec3(centerX, centerY, centerZ), Vec3(upX, upY, upZ));
+		transform = projection * modelView;
+	}
+
+	// цвет очистки (сама очистка выполняется тайлами в flush)
+	void clear(float r, float g, float b)
+	{
+		clearColor = packColor(r, g, b);
+		triangles.clear();
+	}
+
+	void begin(GLenum mode)
+	{
+		primitiveMode = mode;
+		primitive.clear();
+	}
+
+	void color(float r, float g, float b)
+	{
+		currentColor = packColor(r, g, b);
+	}
+
+	void vertex(float x, float y, float z)
+	{
+		// переводим вершину в пространство отсечения одним умножением на projection * modelView
+		ClipVertex clip;
+		Vec4 position = transform.transformPoint(Vec3(x, y, z));
+		std::memcpy(clip.position, position.data(), sizeof(clip.position));
+		clip.color = currentColor;
+		primitive.push_back(clip);
+	}
+
+	// собираем треугольники из накопленных вершин так же, как это делает OpenGL
+	void end()
+	{
+		size_t count = primitive.size();
+		if (primitiveMode == GL_TRIANGLES)
+		{
+			for (size_t i = 0; i + 2 < count; i += 3)
+				addTriangle(primitive[i], primitive[i + 1], primitive[i + 2]);
+		}
+		else if (primitiveMode == GL_TRIANGLE_FAN)
+		{
+			for (size_t i = 1; i + 1 < count; ++i)
+				addTriangle(primitive[0], primitive[i], primitive[i + 1]);
+		}
+		else if (primitiveMode == GL_QUADS)
+		{
+			for (size_t i = 0; i + 3 < count; i += 4)
+			{
+				addTriangle(primitive[i], primitive[i + 1], primitive[i + 2]);
+				addTriangle(primitive[i], primitive[i + 2], primitive[i + 3]);
+			}
+		}
+		primitive.clear();
+	}
+
+	// раскладываем треугольники по тайлам и растеризуем тайлы параллельно
+	void flush()
+	{
+		for (auto& bin : tileBins)
+		{
+			bin.clear();
+		}
+		for (int index = 0; index < static_cast<int>(triangles.size()); ++index)
+		{
+			const ScreenTriangle& tri = triangles[index];
+			int firstTileX = std::max(0, static_cast<int>(tri.minX) / TILE_SIZE);
+			int lastTileX = std::min(tilesX - 1, static_cast<int>(tri.maxX) / TILE_SIZE);
+			int firstTileY = std::max(0, static_cast<int>(tri.minY) / TILE_SIZE);
+			int lastTileY = std::min(tilesY - 1, static_cast<int>(tri.maxY) / TILE_SIZE);
+			for (int ty = firstTileY; ty <= lastTileY; ++ty)
+			{
+				for (int tx = firstTileX; tx <= lastTileX; ++tx)
+				{
+					tileBins[ty * tilesX + tx].push_back(index);
+				}
+			}
+		}
+
+		pool.run(tilesX * tilesY, [this](int tile) { rasterizeTile(tile); });
+	}
+
+	int width() const { return frameWidth; }
+	int height() const { return frameHeight; }
+
+	// пиксели в формате RGBA, строки сверху вниз (подходит для sf::Texture::update и sf::Image::create)
+	const std::uint8_t* pixels() const { return reinterpret_cast<const std::uint8_t*>(colorBuffer.data()); }
+
+	// количество треугольников последнего кадра
+	size_t triangleCount() const { return triangles.size(); }
+
+private:
+	struct ClipVertex
+	{
+		float position[4];
+		std::uint32_t color;
+	};
+
+	struct ScreenTriangle
+	{
+		float x[3], y[3], z[3]; // экранные координаты и глубина [0, 1]
+		float minX, minY, maxX, maxY; // ограничивающий прямоугольник, обрезанный по экрану
+		std::uint32_t color;
+	};
+
+
+	// упаковка в порядке байтов R, G, B, A независимо от порядка байтов платформы
+	static std::uint32_t packColor(float r, float g, float b)
+	{
+		std::uint8_t rgba[4] = {
+			static_cast<std::uint8_t>(std::min(std::max(r, 0.0f), 1.0f) * 255.0f + 0.5f),
+			static_cast<std::uint8_t>(std::min(std::max(g, 0.0f), 1.0f) * 255.0f + 0.5f),
+			static_cast<std::uint8_t>(std::min(std::max(b, 0.0f), 1.0f) * 255.0f + 0.5f),
+			255
+		};
+		std::uint32_t packed;
+		std::memcpy(&packed, rgba, sizeof(packed));
+		return packed;
+	}
+
+	// отсекаем треугольник ближней плоскостью (z >= -w), остальное отсекается по экрану и глубине
+	void addTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c)
+	{
+		const ClipVertex* input[3] = { &a, &b, &c };
+		ClipVertex clipped[4];
+		int clippedCount = 0;
+		for (int i = 0; i < 3; ++i)
+		{
+			const ClipVertex& current = *input[i];
+			const ClipVertex& next = *input[(i + 1) % 3];
+			float dCurrent = current.position[2] + current.position[3];
+			float dNext = next.position[2] + next.position[3];
+			if (dCurrent >= 0.0f)
+			{
+				clipped[clippedCount++] = current;
+			}
+			if ((dCurrent >= 0.0f) != (dNext >= 0.0f))
+			{
+				float t = dCurrent / (dCurrent - dNext);
+				ClipVertex& v = clipped[clippedCount++];
+				for (int k = 0; k < 4; ++k)
+				{
+					v.position[k] = current.position[k] + (next.position[k] - current.position[k]) * t;
+				}
+				v.color = current.color;
+			}
+		}
+
+		for (int i = 1; i + 1 < clippedCount; ++i)
+		{
+			addScreenTriangle(clipped[0], clipped[i], clipped[i + 1], a.color);
+		}
+	}
+
+	void addScreenTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, std::uint32_t color)
+	{
+		const ClipVertex* input[3] = { &a, &b, &c };
+		ScreenTriangle tri;
+		for (int i = 0; i < 3; ++i)
+		{
+			float invW = 1.0f / input[i]->position[3];
+			// преобразование окна (viewport), ось Y направлена вниз
+			tri.x[i] = (input[i]->position[0] * invW * 0.5f + 0.5f) * frameWidth;
+			tri.y[i] = (0.5f - input[i]->position[1] * invW * 0.5f) * frameHeight;
+			tri.z[i] = input[i]->position[2] * invW * 0.5f + 0.5f;
+		}
+
+		// все треугольники приводим к одному обходу (GL_CULL_FACE в L2 не включен)
+		float area = (tri.x[1] - tri.x[0]) * (tri.y[2] - tri.y[0]) - (tri.y[1] - tri.y[0]) * (tri.x[2] - tri.x[0]);
+		if (area == 0.0f || std::isnan(area)) return;
+		if (area < 0.0f)
+		{
+			std::swap(tri.x[1], tri.x[2]);
+			std::swap(tri.y[1], tri.y[2]);
+			std::swap(tri.z[1], tri.z[2]);
+		}
+
+		tri.minX = std::max(0.0f, std::min({ tri.x[0], tri.x[1], tri.x[2] }));
+		tri.minY = std::max(0.0f, std::min({ tri.y[0], tri.y[1], tri.y[2] }));
+		tri.maxX = std::min(frameWidth - 1.0f, std::max({ tri.x[0], tri.x[1], tri.x[2] }));
+		tri.maxY = std::min(frameHeight - 1.0f, std::max({ tri.y[0], tri.y[1], tri.y[2] }));
+		if (tri.minX > tri.maxX || tri.minY > tri.maxY) return; // вне экрана
+
+		tri.color = color;
+		triangles.push_back(tri);
+	}
+
+	// ребро сверху или слева (правило заполнения, чтобы общие ребра не рисовались дважды)
+	static bool isTopLeft(float ax, float ay, float bx, float by)
+	{
+		return (ay == by && bx > ax) || by < ay;
+	}
+
+	void rasterizeTile(int tile)
+	{
+		int tileX0 = (tile % tilesX) * TILE_SIZE;
+		int tileY0 = (tile / tilesX) * TILE_SIZE;
+		int tileX1 = std::min(tileX0 + TILE_SIZE, frameWidth);
+		int tileY1 = std::min(tileY0 + TILE_SIZE, frameHeight);
+
+		// очистка своей части буферов
+		for (int y = tileY0; y < tileY1; ++y)
+		{
+			std::fill(colorBuffer.begin() + y * frameWidth + tileX0, colorBuffer.begin() + y * frameWidth + tileX1, clearColor);
+			std::fill(depthBuffer.begin() + y * frameWidth + tileX0, depthBuffer.begin() + y * frameWidth + tileX1, 1.0f);
+		}
+
+		for (int index : tileBins[tile])
+		{
+			const ScreenTriangle& tri = triangles[index];
+
+			int x0 = std::max(tileX0, static_cast<int>(tri.minX));
+			int x1 = std::min(tileX1 - 1, static_cast<int>(tri.maxX));
+			int y0 = std::max(tileY0, static_cast<int>(tri.minY));
+			int y1 = std::min(tileY1 - 1, static_cast<int>(tri.maxY));
+
+			// коэффициенты функций ребер: w = A * px + B * py + C
+			float edgeA[3], edgeB[3], edgeC[3];
+			bool topLeft[3];
+			for (int e = 0; e < 3; ++e)
+			{
+				int i = (e + 1) % 3, j = (e + 2) % 3; // ребро напротив вершины e
+				edgeA[e] = tri.y[i] - tri.y[j];
+				edgeB[e] = tri.x[j] - tri.x[i];
+				edgeC[e] = tri.x[i] * tri.y[j] - tri.y[i] * tri.x[j];
+				topLeft[e] = isTopLeft(tri.x[i], tri.y[i], tri.x[j], tri.y[j]);
+			}
+			float invArea = 1.0f / (edgeC[0] + edgeC[1] + edgeC[2]);
+
+			for (int y = y0; y <= y1; ++y)
+			{
+				float py = y + 0.5f;
+				float px = x0 + 0.5f;
+				float w[3];
+				for (int e = 0; e < 3; ++e)
+				{
+					w[e] = edgeA[e] * px + edgeB[e] * py + edgeC[e];
+				}
+
+				std::uint32_t* colorRow = colorBuffer.data() + y * frameWidth;
+				float* depthRow = depthBuffer.data() + y * frameWidth;
+				for (int x = x0; x <= x1; ++x)
+				{
+					bool inside = true;
+					for (int e = 0; e < 3; ++e)
+					{
+						inside = inside && (w[e] > 0.0f || (w[e] == 0.0f && topLeft[e]));
+					}
+					if (inside)
+					{
+						float depth = (w[0] * tri.z[0] + w[1] * tri.z[1] + w[2] * tri.z[2]) * invArea;
+						if (depth >= 0.0f && depth < depthRow[x]) // тест глубины GL_LESS
+						{
+							depthRow[x] = depth;
+							colorRow[x] = tri.color;
+						}
+					}
+					for (int e = 0; e < 3; ++e)
+					{
+						w[e] += edgeA[e];
+					}
+				}
+			}
+		}
+	}
+
+	int frameWidth, frameHeight;
+	int tilesX, tilesY;
+	std::vector<std::uint32_t> colorBuffer;
+	std::vector<float> depthBuffer;
+	std::vector<std::vector<int>> tileBins; // индексы треугольников для каждого тайла
+	std::vector<ScreenTriangle> triangles;
+	std::vector<ClipVertex> primitive; // вершины текущего glBegin/glEnd
+	GLenum primitiveMode = GL_TRIANGLES;
+	std::uint32_t currentColor = 0xFFFFFFFFu;
+	std::uint32_t clearColor = 0xFFFFFFFFu;
+	Mat4 projection;
+	Mat4 modelView;
+	Mat4 transform; // projection * modelView, пересчитывается при смене камеры
+	WorkerPool pool;
+};
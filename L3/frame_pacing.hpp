@@ -0,0 +1,107 @@
+// симуляция с постоянным шагом и ограничение частоты кадров
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+
+// Способ ограничения частоты кадров
+enum class PacingMode
+{
+	Capped,   // ждем сами до начала следующего кадра (по умолчанию)
+	VSync,    // ждет драйвер при выводе кадра
+	Uncapped  // без ограничения, для замеров
+};
+
+inline PacingMode parsePacingMode(const std::string& name)
+{
+	if (name == "vsync") return PacingMode::VSync;
+	if (name == "uncapped") return PacingMode::Uncapped;
+	return PacingMode::Capped;
+}
+
+// Постоянный шаг симуляции: накопленное время кадров расходуется целыми шагами,
+// остаток (alpha) используется для интерполяции между двумя последними состояниями при отрисовке
+class FixedTimestep
+{
+public:
+	explicit FixedTimestep(double stepSeconds, int maxStepsPerFrame = 8)
+		: stepSeconds(stepSeconds), maxStepsPerFrame(maxStepsPerFrame)
+	{
+	}
+
+	// сколько шагов сделать за кадр длиной frameSeconds; после долгой паузы (перетаскивание окна, отладчик)
+	// лишние шаги отбрасываются, чтобы симуляция не пыталась догнать время бесконечно
+	int advance(double frameSeconds)
+	{
+		accumulator += std::min(frameSeconds, stepSeconds * maxStepsPerFrame);
+		int steps = static_cast<int>(accumulator / stepSeconds);
+		accumulator -= steps * stepSeconds;
+		return steps;
+	}
+
+	float step() const { return static_cast<float>(stepSeconds); }
+
+	// доля шага, прошедшая после последнего шага симуляции, в [0, 1)
+	float alpha() const { return static_cast<float>(accumulator / stepSeconds); }
+
+private:
+	double stepSeconds;
+	int maxStepsPerFrame;
+	double accumulator = 0.0;
+};
+
+// Ожидание начала следующего кадра. Большую часть времени поток спит и не занимает ядро,
+// последние доли миллисекунды (с запасом на неточность sleep) уступает процессор через yield,
+// чтобы проснуться точно к сроку. Ждать лучше в начале кадра, перед опросом ввода, - тогда ввод
+// считывается как можно позже и задержка до вывода на экран меньше.
+class FramePacer
+{
+public:
+	explicit FramePacer(double framesPerSecond)
+	{
+		setRate(framesPerSecond);
+	}
+
+	void setRate(double framesPerSecond)
+	{
+		period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / framesPerSecond));
+		next = Clock::now();
+	}
+
+	void wait()
+	{
+		const Clock::duration minMargin = std::chrono::microseconds(200), maxMargin = std::chrono::microseconds(4000);
+		Clock::time_point now = Clock::now();
+		while (now < next)
+		{
+			Clock::duration remaining = next - now;
+			if (remaining > sleepMargin)
+			{
+				Clock::duration request = remaining - sleepMargin;
+				std::this_thread::sleep_for(request);
+				Clock::time_point woke = Clock::now();
+				// запас держим около удвоенного среднего опоздания при пробуждении (на Windows до 1-2 мс)
+				Clock::duration oversleep = (woke - now) - request;
+				sleepMargin = std::min(maxMargin, std::max(minMargin, (sleepMargin * 7 + oversleep * 2) / 8));
+				now = woke;
+			}
+			else
+			{
+				std::this_thread::yield();
+				now = Clock::now();
+			}
+		}
+
+		// если отстали больше чем на кадр, не пытаемся догонять пачкой кадров без ожидания
+		next = std::max(next + period, now);
+	}
+
+private:
+	using Clock = std::chrono::steady_clock;
+	Clock::duration period;
+	Clock::time_point next;
+	Clock::duration sleepMargin = std::chrono::microseconds(1000);
+};
@@ -1,79 +1,54 @@
 #include <SFML/Window.hpp>
+#include <GL/glew.h>
 #include <SFML/OpenGL.hpp>
-#include <GL/glu.h>
+#include <chrono>
 #include <cmath>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <string>
+
+#include "frame_pacing.hpp"
+#include "orbits.hpp"
+#include "scene_buffers.hpp"
+#include "../common/async_log.hpp"
+#include "../common/gpu_timer.hpp"
+#include "../common/headless.hpp"
+#include "../common/profiler.hpp"
+#include "../common/vector_math.hpp"
 
 const float PI = 3.14159265358979323846;
 float angle = 0.0f;      // Начальная позиция на окружности
 float radiusX = 5.0f;   // Радиус по оси X
 float radiusZ = 5.0f;   // Радиус по оси Z
 float speed = 0.01f;     // Скорость движения по окружности
+float previousAngle = 0.0f; // Угол на предыдущем шаге симуляции (для интерполяции)
 
-// Рисуем куб
-void drawCube()
-{
-	glBegin(GL_QUADS); // Рисуем четырехугольники
+const double SIMULATION_STEP = 1.0 / 120.0; // Шаг симуляции в секундах, не зависит от частоты кадров
+const double IDLE_FRAME_RATE = 10.0;        // Частота кадров, когда окно не в фокусе
 
+// Рисуем куб из буфера (вершины загружены один раз)
+void drawCube(const CubeMesh& cube)
+{
 	glColor3f(1.0f, 0.0f, 0.0f); // Красный цвет
-
-	// Передняя грань
-	glVertex3f(-1.0f, -1.0f, 1.0f);
-	glVertex3f(1.0f, -1.0f, 1.0f);
-	glVertex3f(1.0f, 1.0f, 1.0f);
-	glVertex3f(-1.0f, 1.0f, 1.0f);
-
-	// Задняя грань
-	glVertex3f(-1.0f, -1.0f, -1.0f);
-	glVertex3f(-1.0f, 1.0f, -1.0f);
-	glVertex3f(1.0f, 1.0f, -1.0f);
-	glVertex3f(1.0f, -1.0f, -1.0f);
-
-	// Верхняя грань
-	glVertex3f(-1.0f, 1.0f, -1.0f);
-	glVertex3f(-1.0f, 1.0f, 1.0f);
-	glVertex3f(1.0f, 1.0f, 1.0f);
-	glVertex3f(1.0f, 1.0f, -1.0f);
-
-	// Нижняя грань
-	glVertex3f(-1.0f, -1.0f, -1.0f);
-	glVertex3f(1.0f, -1.0f, -1.0f);
-	glVertex3f(1.0f, -1.0f, 1.0f);
-	glVertex3f(-1.0f, -1.0f, 1.0f);
-
-	// Левая грань
-	glVertex3f(-1.0f, -1.0f, -1.0f);
-	glVertex3f(-1.0f, -1.0f, 1.0f);
-	glVertex3f(-1.0f, 1.0f, 1.0f);
-	glVertex3f(-1.0f, 1.0f, -1.0f);
-
-	// Правая грань
-	glVertex3f(1.0f, -1.0f, -1.0f);
-	glVertex3f(1.0f, 1.0f, -1.0f);
-	glVertex3f(1.0f, 1.0f, 1.0f);
-	glVertex3f(1.0f, -1.0f, 1.0f);
-
-	glEnd();
+	cube.draw();
 }
 
-// Рисуем круговую траекторию
-void drawTrajectory(float radiusX, float radiusZ)
+// Рисуем эллиптическую траекторию, перестраивая буфер только при смене радиусов
+void drawTrajectory(TrajectoryMesh& trajectory, float radiusX, float radiusZ)
 {
-	glColor3f(0.8f, 0.0f, 0.0f); // Красный темный цвет 
-	glBegin(GL_LINE_LOOP);
-	for (int i = 0; i < 360; i++) 
+	if (trajectory.update(radiusX, radiusZ))
 	{
-		float theta = i * PI / 180.0f; // Переводим угол в радианы
-		float x = radiusX * cos(theta); // Радиус по оси X
-		float z = radiusZ * sin(theta); // Радиус по оси Z
-		glVertex3f(x, 0.0f, z); // Рисуем точку
+		AsyncLog::instance().write("Trajectory segments: {}", trajectory.segments());
 	}
-	glEnd();
+	glColor3f(0.8f, 0.0f, 0.0f); // Красный темный цвет 
+	trajectory.draw();
 }
 
-// Обновляем позицию куба
+// Обновляем позицию куба (один шаг симуляции)
 void update(float deltaTime)
 {
+	previousAngle = angle;
 	angle += speed * deltaTime; // Изменение угла
 	if (angle >= 2 * PI) 
 	{
@@ -81,11 +56,87 @@ void update(float deltaTime)
 	}
 }
 
-int main()
+// Угол куба между двумя последними шагами симуляции, alpha в [0, 1)
+float interpolatedAngle(float alpha)
+{
+	float delta = angle - previousAngle;
+	if (delta < -PI) delta += 2 * PI; // угол перескочил через 2PI
+	return previousAngle + delta * alpha;
+}
+
+// Замер обновления орбит без окна
+int runOrbitBenchmark(size_t bodies, int steps)
 {
-	// Создаем окно
-	sf::Window window(sf::VideoMode(1200, 1000), "KUB PO KRUGU", sf::Style::Close | sf::Style::Titlebar);
-	window.setActive(true);
+	OrbitSystem orbits;
+	orbits.generate(bodies, 12345);
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < steps; i++)
+	{
+		orbits.update(1.0f / 60.0f);
+	}
+	double total = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << "Bodies: " << bodies << ", steps: " << steps << ", pool threads: " << WorkerPool::shared().threadCount() << std::endl;
+	std::cout << "Update: " << total / steps << " ms per step, " << total * 1.0e6 / (static_cast<double>(steps) * bodies) << " ns per body" << std::endl;
+	return 0;
+}
+
+// Параметры запуска (можно сочетать):
+//   без аргументов                        - один куб на эллиптической траектории, 60 кадров в секунду
+//   --bodies <количество>                 - вокруг сцены движется еще множество тел на своих орбитах,
+//                                           каждые 60 кадров выводится среднее время обновления орбит и кадра
+//   --pacing capped|vsync|uncapped        - ограничение частоты кадров: свое ожидание, вертикальная синхронизация
+//                                           или без ограничения (для замеров)
+//   --fps <частота>                       - частота кадров для capped
+//   --orbit-bench <тела> <шаги>           - замер обновления орбит без окна
+//   --profile [файл.csv]                  - замер времени этапов кадра (на видеокарте тоже, если есть таймеры OpenGL)
+//   --headless [кадры] [файл.ppm]         - без окна (EGL): кадры (по умолчанию 300) без ожидания, каждый сдвигает
+//                                           симуляцию на 1/fps секунды; последний кадр сохраняется (по умолчанию L3_frame.ppm)
+int main(int argc, char* argv[])
+{
+	FrameProfiler::instance().configure(argc, argv);
+	size_t bodyCount = 0;
+	PacingMode pacing = PacingMode::Capped;
+	double targetFrameRate = 60.0;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string option = argv[i];
+		bool hasValue = i + 1 < argc && argv[i + 1][0] != '-';
+		if (option == "--orbit-bench")
+		{
+			return runOrbitBenchmark(hasValue ? std::strtoull(argv[i + 1], nullptr, 10) : 100000, i + 2 < argc ? std::atoi(argv[i + 2]) : 600);
+		}
+		else if (option == "--bodies")
+		{
+			bodyCount = hasValue ? std::strtoull(argv[++i], nullptr, 10) : 50000;
+		}
+		else if (option == "--pacing" && hasValue)
+		{
+			pacing = parsePacingMode(argv[++i]);
+		}
+		else if (option == "--fps" && hasValue)
+		{
+			targetFrameRate = std::atof(argv[++i]);
+		}
+	}
+
+	// Создаем окно (или кадровый буфер без окна)
+	HeadlessRenderer headless;
+	headless.configure(argc, argv, "L3_frame.ppm");
+	std::unique_ptr<sf::Window> window;
+	if (headless.isEnabled())
+	{
+		if (!headless.create(1200, 1000))
+			return 1;
+	}
+	else
+	{
+		window.reset(new sf::Window(sf::VideoMode(1200, 1000), "KUB PO KRUGU", sf::Style::Close | sf::Style::Titlebar));
+		window->setActive(true);
+		window->setVerticalSyncEnabled(pacing == PacingMode::VSync);
+		glewInit(); // загружаем функции для работы с буферами вершин
+	}
 
 	// Настройки OpenGL
 	glEnable(GL_DEPTH_TEST); // Включаем тест глубины (для 3D объектов)
@@ -94,7 +145,7 @@ int main()
 	// Установка перспективы
 	glMatrixMode(GL_PROJECTION); // Работа с матрицей проекции (преобразование 3D сцены в 2D изображение)
 	glLoadIdentity();
-	gluPerspective(60.0, 1200.0 / 1000.0, 1.0, 100.0);
+	glMultMatrixf(Mat4::perspective(60.0f, 1200.0f / 1000.0f, 1.0f, bodyCount > 0 ? 200.0f : 100.0f).data()); // орбиты тел доходят до 50 от центра
 	// fovy — поле зрения по вертикали(в градусах), то есть угол, на который «расходится» видимая область вверх и вниз.
 	// aspect — соотношение сторон окна(ширина / высота).Это значение помогает OpenGL корректно отображать изображение, чтобы оно не было искажено.
 	// zNear — ближняя отсечка.Объекты, находящиеся ближе, чем это расстояние от камеры, не будут видны.
@@ -103,73 +154,176 @@ int main()
 	glMatrixMode(GL_MODELVIEW); // Настраиваем сцену
 	glLoadIdentity();
 
+	// Геометрия в буферах на видеокарте
+	CubeMesh cube;
+	TrajectoryMesh trajectory;
+
+	// Тела на своих орбитах (только в режиме --bodies)
+	OrbitSystem orbits;
+	std::unique_ptr<OrbitRenderer> orbitRenderer;
+	if (bodyCount > 0)
+	{
+		orbits.generate(bodyCount, 12345);
+		orbitRenderer.reset(new OrbitRenderer(cube, orbits));
+		if (!orbitRenderer->isReady())
+			return 1;
+	}
+	double updateTime = 0.0, frameTime = 0.0; // суммы за последние кадры в миллисекундах
+	int statFrames = 0;
+
+	FixedTimestep timestep(SIMULATION_STEP);
+	FramePacer pacer(targetFrameRate);
+	FramePacer idlePacer(IDLE_FRAME_RATE);
+	bool focused = true;
+
+	GpuStageTimer gpuDrawTimer("draw"); // время отрисовки на видеокарте
+
 	sf::Clock clock; // Часы для отслеживания времени
 
-	while (window.isOpen())
+	while (window ? window->isOpen() : headless.isOpen())
 	{
+		// Ждем начала кадра до опроса ввода, чтобы ввод попадал в кадр как можно свежее.
+		// Без фокуса окно перерисовывается редко и почти не занимает процессор. Без окна кадры не ждут
+		PROFILE_BEGIN(waitTimer, "wait");
+		if (window && !focused && pacing != PacingMode::Uncapped)
+			idlePacer.wait();
+		else if (window && pacing == PacingMode::Capped)
+			pacer.wait();
+		waitTimer.stop();
+
+		PROFILE_BEGIN(inputTimer, "input");
 		sf::Event event;
-		while (window.pollEvent(event))
+		while (window && window->pollEvent(event))
 		{
 			if (event.type == sf::Event::Closed)
-				window.close();
+				window->close();
+
+			if (event.type == sf::Event::LostFocus)
+				focused = false;
+			if (event.type == sf::Event::GainedFocus)
+				focused = true;
 
 			if (event.type == sf::Event::KeyPressed)
 			{
 				if (event.key.code == sf::Keyboard::Up)
 				{
 					speed += 0.05f; // Увеличиваем скорость
-					std::cout << "Speed increased: " << speed << std::endl;
+					AsyncLog::instance().write("Speed increased: {}", speed);
 				}
 				else if (event.key.code == sf::Keyboard::Down)
 				{
 					speed -= 0.05f; // Уменьшаем скорость
-					std::cout << "Speed decreased: " << speed << std::endl;
+					AsyncLog::instance().write("Speed decreased: {}", speed);
 				}
 				else if (event.key.code == sf::Keyboard::W)
 				{
 					radiusX += 0.1f; // Увеличиваем радиус по X
-					std::cout << "Radius X increased: " << radiusX << std::endl;
+					AsyncLog::instance().write("Radius X increased: {}", radiusX);
 				}
 				else if (event.key.code == sf::Keyboard::S)
 				{
 					if (radiusX > 0.1f)
 					{ // Уменьшаем радиус по X
 						radiusX -= 0.1f;
-						std::cout << "Radius X decreased: " << radiusX << std::endl;
+						AsyncLog::instance().write("Radius X decreased: {}", radiusX);
 					}
 				}
 			}
 		}
 
+		inputTimer.stop();
+
+		auto frameStart = std::chrono::steady_clock::now();
 		float deltaTime = clock.restart().asSeconds(); // Получаем прошедшее время 
-		update(deltaTime); // Обновляем угол
+		if (!window)
+			deltaTime = static_cast<float>(1.0 / targetFrameRate); // без окна время симуляции не зависит от скорости отрисовки
+
+		// Симуляция идет постоянными шагами, сколько их уместилось в прошедшее время
+		PROFILE_BEGIN(simulateTimer, "simulate");
+		int steps = timestep.advance(deltaTime);
+		for (int i = 0; i < steps; i++)
+		{
+			update(timestep.step()); // Обновляем угол
+			if (orbitRenderer)
+				orbits.advance(timestep.step()); // Сдвигаем все тела
+		}
+
+		simulateTimer.stop();
+
+		// Рисуем состояние между двумя последними шагами, чтобы движение было плавным при любой частоте кадров
+		PROFILE_BEGIN(interpolateTimer, "interpolate");
+		float alpha = timestep.alpha();
+		float renderAngle = interpolatedAngle(alpha);
+		if (orbitRenderer)
+		{
+			orbits.computePositions((alpha - 1.0f) * timestep.step());
+			updateTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+		}
+		interpolateTimer.stop();
 
+		PROFILE_BEGIN(drawTimer, "draw");
+		gpuDrawTimer.begin();
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // Очищаем экран (если закомментить, будет прикол)
 
 		glLoadIdentity(); // Сбрасываем матрицу
 
 		// Рассчитываем текущее положение куба
-		float cubeX = radiusX * cos(angle); // Используем радиус по оси X
-		float cubeZ = radiusZ * sin(angle); // Используем радиус по оси Z
+		float cubeX = radiusX * cos(renderAngle); // Используем радиус по оси X
+		float cubeZ = radiusZ * sin(renderAngle); // Используем радиус по оси Z
 		float cubeY = 0.0f;
 
 		// Установка позиции и ориентации камеры, направляем её на куб
 		float cameraX = 0.0f;
 		float cameraY = 8.0f;   // Камера находится выше
 		float cameraZ = 10.0f;  // Камера дальше по оси Z
-		gluLookAt(cameraX, cameraY, cameraZ, cubeX, cubeY, cubeZ, 0.0f, 1.0f, 0.0f);
+		if (orbitRenderer)
+		{
+			// С телами камера отодвигается и смотрит в центр, чтобы были видны все орбиты
+			glMultMatrixf(Mat4::lookAt(Vec3(cameraX, 40.0f, 70.0f), Vec3(0.0f, 0.0f, 0.0f), Vec3(0.0f, 1.0f, 0.0f)).data());
+		}
+		else
+		{
+			glMultMatrixf(Mat4::lookAt(Vec3(cameraX, cameraY, cameraZ), Vec3(cubeX, cubeY, cubeZ), Vec3(0.0f, 1.0f, 0.0f)).data());
+		}
 		// (откуда, куда, ориентация (Y вверху))
 
-		drawTrajectory(radiusX, radiusZ); // Рисуем эллиптическую траекторию
+		drawTrajectory(trajectory, radiusX, radiusZ); // Рисуем эллиптическую траекторию
 
 		// Перемещаем куб по эллиптической траектории
 		glPushMatrix(); // Сохраняем текущую матрицу 
 		glTranslatef(cubeX, cubeY, cubeZ); // Позиционируем куб по эллипсу
-		drawCube(); // Рисуем куб
+		drawCube(cube); // Рисуем куб
 		glPopMatrix(); // Восстанавливаем матрицу 
 
-		window.display(); // Отображаем содержимое окна
+		if (orbitRenderer)
+		{
+			orbitRenderer->draw(orbits); // Все тела одним вызовом
+		}
+		gpuDrawTimer.end();
+		drawTimer.stop();
+
+		PROFILE_BEGIN(displayTimer, "display");
+		if (window)
+			window->display(); // Отображаем содержимое окна
+		else
+			headless.display();
+		displayTimer.stop();
+		FrameProfiler::instance().endFrame();
+
+		if (orbitRenderer)
+		{
+			frameTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+			if (++statFrames >= 60)
+			{
+				AsyncLog::instance().write("Bodies: {}, update {} ms, frame {} ms", orbits.size(), updateTime / statFrames, frameTime / statFrames);
+				updateTime = frameTime = 0.0;
+				statFrames = 0;
+			}
+		}
 	}
+	bool saved = !headless.isEnabled() || headless.finish(); // последний кадр без окна - в файл
+	AsyncLog::instance().flush(); // последние сообщения до итоговой сводки
+	FrameProfiler::instance().finish();
 
-	return 0;
+	return saved ? 0 : 1;
 }
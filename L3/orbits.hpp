@@ -0,0 +1,283 @@
+// множество тел на собственных эллиптических орбитах, все рисуются одним вызовом с инстансингом
+
+#pragma once
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../common/sincos.hpp"
+#include "../common/worker_pool.hpp"
+#include "scene_buffers.hpp"
+
+// Параметры и положения тел хранятся отдельными массивами (SoA), чтобы ядро обновления
+// обрабатывало по четыре тела за раз и писало координаты сразу в том виде, в каком они уходят на видеокарту
+class OrbitSystem
+{
+public:
+	// случайные орбиты вокруг начала координат
+	void generate(size_t count, unsigned seed)
+	{
+		std::mt19937 generator(seed);
+		std::uniform_real_distribution<float> radiusDistribution(3.0f, 50.0f);
+		std::uniform_real_distribution<float> flattening(0.6f, 1.0f);
+		std::uniform_real_distribution<float> phase(0.0f, 2.0f * PI_F);
+		std::uniform_real_distribution<float> heightDistribution(-1.5f, 1.5f);
+		std::uniform_real_distribution<float> scaleDistribution(0.05f, 0.2f);
+
+		radiusX.resize(count);
+		radiusZ.resize(count);
+		angle.resize(count);
+		speed.resize(count);
+		positionX.resize(count);
+		positionY.resize(count);
+		positionZ.resize(count);
+		scale.resize(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			float radius = radiusDistribution(generator);
+			radiusX[i] = radius;
+			radiusZ[i] = radius * flattening(generator);
+			angle[i] = phase(generator);
+			speed[i] = 2.0f / std::sqrt(radius); // дальние тела движутся медленнее
+			positionY[i] = heightDistribution(generator);
+			scale[i] = scaleDistribution(generator);
+		}
+		update(0.0f);
+	}
+
+	// сдвигаем все тела на deltaTime секунд и сразу считаем их координаты
+	void update(float deltaTime)
+	{
+		advance(deltaTime);
+		computePositions(0.0f);
+	}
+
+	// шаг симуляции: меняются только углы, координаты считаются при отрисовке
+	void advance(float deltaTime)
+	{
+		parallelFor([this, deltaTime](size_t begin, size_t end) { advanceRange(begin, end, deltaTime); });
+	}
+
+	// координаты тел в момент timeOffset секунд относительно последнего шага (для интерполяции между шагами timeOffset < 0).
+	// Движение по орбите равномерное, поэтому промежуточное положение считается точно по углу
+	void computePositions(float timeOffset)
+	{
+		parallelFor([this, timeOffset](size_t begin, size_t end) { positionRange(begin, end, timeOffset); });
+	}
+
+	size_t size() const { return angle.size(); }
+	const float* x() const { return positionX.data(); }
+	const float* y() const { return positionY.data(); }
+	const float* z() const { return positionZ.data(); }
+	const float* scales() const { return scale.data(); }
+
+private:
+	static constexpr float PI_F = 3.14159265358979323846f;
+	static constexpr size_t PARALLEL_CHUNK = 1 << 16; // меньше этого на поток делить работу невыгодно
+
+	// большие наборы делятся между потоками общего пула (потоки не создаются на каждый шаг)
+	template <typename Kernel>
+	void parallelFor(Kernel kernel)
+	{
+		WorkerPool::shared().parallelFor(size(), PARALLEL_CHUNK, kernel);
+	}
+
+	// angle += speed * dt в пределах 0 - 2PI (цикл без ветвлений, компилятор векторизует его сам)
+	void advanceRange(size_t begin, size_t end, float deltaTime)
+	{
+		const float fullTurn = 2.0f * PI_F;
+		for (size_t i = begin; i < end; ++i)
+		{
+			float a = angle[i] + speed[i] * deltaTime;
+			a -= a >= fullTurn ? fullTurn : 0.0f;
+			a += a < 0.0f ? fullTurn : 0.0f;
+			angle[i] = a;
+		}
+	}
+
+	// x = radiusX * cos(angle + speed * offset), z = radiusZ * sin(angle + speed * offset)
+	void positionRange(size_t begin, size_t end, float timeOffset)
+	{
+		size_t i = begin;
+#ifdef SINCOS_USE_SSE2
+		const __m128 offset = _mm_set1_ps(timeOffset);
+		for (; i + 4 <= end; i += 4)
+		{
+			__m128 a = _mm_add_ps(_mm_loadu_ps(&angle[i]), _mm_mul_ps(_mm_loadu_ps(&speed[i]), offset));
+			__m128 sinValue, cosValue;
+			sinCos4(a, sinValue, cosValue);
+			_mm_storeu_ps(&positionX[i], _mm_mul_ps(_mm_loadu_ps(&radiusX[i]), cosValue));
+			_mm_storeu_ps(&positionZ[i], _mm_mul_ps(_mm_loadu_ps(&radiusZ[i]), sinValue));
+		}
+#endif
+		for (; i < end; ++i)
+		{
+			float sinValue, cosValue;
+			sinCos(angle[i] + speed[i] * timeOffset, sinValue, cosValue);
+			positionX[i] = radiusX[i] * cosValue;
+			positionZ[i] = radiusZ[i] * sinValue;
+		}
+	}
+
+	std::vector<float> radiusX, radiusZ;           // радиусы орбиты
+	std::vector<float> angle, speed;               // положение на орбите и угловая скорость
+	std::vector<float> positionX, positionY, positionZ; // текущие координаты (y не меняется)
+	std::vector<float> scale;                      // размер куба
+};
+
+// Все тела - один glDrawArraysInstanced: вершины куба общие, а координаты и размеры тел
+// лежат в одном буфере подряд [x... | y... | z... | scale...] и подаются как атрибуты с делителем 1
+class OrbitRenderer
+{
+public:
+	OrbitRenderer(const CubeMesh& cube, const OrbitSystem& orbits)
+		: count(static_cast<GLsizei>(orbits.size())), cubeVertexCount(cube.buffer().vertexCount())
+	{
+		program = createProgram();
+		colorLocation = glGetUniformLocation(program, "color");
+
+		glGenVertexArrays(1, &vertexArray);
+		glBindVertexArray(vertexArray);
+
+		glBindBuffer(GL_ARRAY_BUFFER, cube.buffer().id());
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+		size_t arrayBytes = orbits.size() * sizeof(float);
+		glGenBuffers(1, &instanceBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+		glBufferData(GL_ARRAY_BUFFER, arrayBytes * 4, nullptr, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, arrayBytes, arrayBytes, orbits.y()); // высота и размер не меняются
+		glBufferSubData(GL_ARRAY_BUFFER, arrayBytes * 3, arrayBytes, orbits.scales());
+		for (GLuint attribute = 1; attribute <= 4; ++attribute)
+		{
+			glEnableVertexAttribArray(attribute);
+			glVertexAttribPointer(attribute, 1, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<const void*>(arrayBytes * (attribute - 1)));
+			glVertexAttribDivisor(attribute, 1);
+		}
+
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	// false, если шейдеры не собрались (ошибка уже выведена): тела не нарисуются
+	bool isReady() const { return program != 0; }
+
+	OrbitRenderer(const OrbitRenderer&) = delete;
+	OrbitRenderer& operator=(const OrbitRenderer&) = delete;
+
+	~OrbitRenderer()
+	{
+		glDeleteBuffers(1, &instanceBuffer);
+		glDeleteVertexArrays(1, &vertexArray);
+		glDeleteProgram(program);
+	}
+
+	// загружаем новые x и z и рисуем все тела (матрицы берутся из текущего состояния OpenGL)
+	void draw(const OrbitSystem& orbits)
+	{
+		size_t arrayBytes = orbits.size() * sizeof(float);
+		glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, arrayBytes, orbits.x());
+		glBufferSubData(GL_ARRAY_BUFFER, arrayBytes * 2, arrayBytes, orbits.z());
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		glUseProgram(program);
+		glUniform3f(colorLocation, 0.1f, 0.3f, 0.9f);
+		glBindVertexArray(vertexArray);
+		glDrawArraysInstanced(GL_QUADS, 0, cubeVertexCount, count);
+		glBindVertexArray(0);
+		glUseProgram(0);
+	}
+
+private:
+	static GLuint createProgram()
+	{
+		// профиль compatibility: матрицы проекции и камеры из фиксированного конвейера (Mat4::perspective/lookAt), как и у остальной сцены
+		const char* vertexSource = R"(
+			#version 330 compatibility
+			layout(location = 0) in vec3 position;
+			layout(location = 1) in float bodyX;
+			layout(location = 2) in float bodyY;
+			layout(location = 3) in float bodyZ;
+			layout(location = 4) in float bodyScale;
+			out vec3 worldPosition;
+			void main() {
+				worldPosition = position * bodyScale + vec3(bodyX, bodyY, bodyZ);
+				gl_Position = gl_ModelViewProjectionMatrix * vec4(worldPosition, 1.0);
+			}
+		)";
+		// грани куба различаем по нормали, восстановленной из производных позиции
+		const char* fragmentSource = R"(
+			#version 330 compatibility
+			in vec3 worldPosition;
+			uniform vec3 color;
+			out vec4 fragColor;
+			void main() {
+				vec3 normal = normalize(cross(dFdx(worldPosition), dFdy(worldPosition)));
+				float light = 0.4 + 0.6 * abs(dot(normal, normalize(vec3(0.3, 1.0, 0.5))));
+				fragColor = vec4(color * light, 1.0);
+			}
+		)";
+
+		// профиль compatibility есть не у всех драйверов (core, GLES), поэтому ошибки сборки выводим, а не теряем тела молча
+		GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexSource);
+		GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
+		if (vertexShader == 0 || fragmentShader == 0)
+		{
+			glDeleteShader(vertexShader);
+			glDeleteShader(fragmentShader);
+			return 0;
+		}
+
+		GLuint shaderProgram = glCreateProgram();
+		glAttachShader(shaderProgram, vertexShader);
+		glAttachShader(shaderProgram, fragmentShader);
+		glLinkProgram(shaderProgram);
+		glDeleteShader(vertexShader); // после сборки программы шейдеры больше не нужны
+		glDeleteShader(fragmentShader);
+
+		GLint success = GL_FALSE;
+		glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
+		if (success != GL_TRUE)
+		{
+			GLint logLength = 0;
+			glGetProgramiv(shaderProgram, GL_INFO_LOG_LENGTH, &logLength);
+			std::vector<char> log(logLength > 1 ? logLength : 1, '\0');
+			glGetProgramInfoLog(shaderProgram, static_cast<GLsizei>(log.size()), nullptr, log.data());
+			std::cerr << "Orbit shader link failed:\n" << log.data() << std::endl;
+			glDeleteProgram(shaderProgram);
+			return 0;
+		}
+		return shaderProgram;
+	}
+
+	static GLuint compileShader(GLenum type, const char* source)
+	{
+		GLuint shader = glCreateShader(type);
+		glShaderSource(shader, 1, &source, nullptr);
+		glCompileShader(shader);
+		GLint success = GL_FALSE;
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+		if (success == GL_TRUE) return shader;
+
+		GLint logLength = 0;
+		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
+		std::vector<char> log(logLength > 1 ? logLength : 1, '\0');
+		glGetShaderInfoLog(shader, static_cast<GLsizei>(log.size()), nullptr, log.data());
+		std::cerr << "Orbit " << (type == GL_VERTEX_SHADER ? "vertex" : "fragment") << " shader failed:\n" << log.data() << std::endl;
+		glDeleteShader(shader);
+		return 0;
+	}
+
+	GLsizei count;           // количество тел
+	GLsizei cubeVertexCount;
+	GLuint program = 0;
+	GLint colorLocation = -1;
+	GLuint vertexArray = 0;
+	GLuint instanceBuffer = 0;
+};
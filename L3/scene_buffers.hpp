@@ -0,0 +1,140 @@
+// вершинные буферы куба и траектории, которые создаются один раз и хранятся на видеокарте
+
+#pragma once
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <vector>
+
+// Буфер с позициями вершин (x, y, z), рисуется через glVertexPointer, цвет задается glColor
+class VertexBufferObject
+{
+public:
+	VertexBufferObject() = default;
+	VertexBufferObject(const VertexBufferObject&) = delete;
+	VertexBufferObject& operator=(const VertexBufferObject&) = delete;
+
+	~VertexBufferObject()
+	{
+		if (buffer != 0) glDeleteBuffers(1, &buffer);
+	}
+
+	// загружаем вершины; если их число не изменилось, буфер переписывается на месте
+	void upload(const std::vector<float>& positions, GLenum usage)
+	{
+		if (buffer == 0) glGenBuffers(1, &buffer);
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		GLsizei newCount = static_cast<GLsizei>(positions.size() / 3);
+		if (newCount == count)
+			glBufferSubData(GL_ARRAY_BUFFER, 0, positions.size() * sizeof(float), positions.data());
+		else
+			glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(float), positions.data(), usage);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		count = newCount;
+	}
+
+	void draw(GLenum mode) const
+	{
+		if (count == 0) return;
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glVertexPointer(3, GL_FLOAT, 0, nullptr);
+		glDrawArrays(mode, 0, count);
+		glDisableClientState(GL_VERTEX_ARRAY);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	GLsizei vertexCount() const { return count; }
+	GLuint id() const { return buffer; }
+
+private:
+	GLuint buffer = 0;
+	GLsizei count = 0;
+};
+
+// Куб со стороной 2 с центром в начале координат (грани GL_QUADS в том же порядке, что и раньше)
+class CubeMesh
+{
+public:
+	CubeMesh()
+	{
+		const float positions[] = {
+			// Передняя грань
+			-1.0f, -1.0f, 1.0f,   1.0f, -1.0f, 1.0f,   1.0f, 1.0f, 1.0f,   -1.0f, 1.0f, 1.0f,
+			// Задняя грань
+			-1.0f, -1.0f, -1.0f,  -1.0f, 1.0f, -1.0f,  1.0f, 1.0f, -1.0f,  1.0f, -1.0f, -1.0f,
+			// Верхняя грань
+			-1.0f, 1.0f, -1.0f,   -1.0f, 1.0f, 1.0f,   1.0f, 1.0f, 1.0f,   1.0f, 1.0f, -1.0f,
+			// Нижняя грань
+			-1.0f, -1.0f, -1.0f,  1.0f, -1.0f, -1.0f,  1.0f, -1.0f, 1.0f,  -1.0f, -1.0f, 1.0f,
+			// Левая грань
+			-1.0f, -1.0f, -1.0f,  -1.0f, -1.0f, 1.0f,  -1.0f, 1.0f, 1.0f,  -1.0f, 1.0f, -1.0f,
+			// Правая грань
+			1.0f, -1.0f, -1.0f,   1.0f, 1.0f, -1.0f,   1.0f, 1.0f, 1.0f,   1.0f, -1.0f, 1.0f
+		};
+		vertices.upload(std::vector<float>(std::begin(positions), std::end(positions)), GL_STATIC_DRAW);
+	}
+
+	void draw() const { vertices.draw(GL_QUADS); }
+
+	const VertexBufferObject& buffer() const { return vertices; }
+
+private:
+	VertexBufferObject vertices;
+};
+
+// Эллипс траектории в плоскости y = 0. Вершины пересчитываются только при смене радиусов,
+// число отрезков подбирается так, чтобы хорда отходила от эллипса не больше чем на tolerance
+class TrajectoryMesh
+{
+public:
+	explicit TrajectoryMesh(float tolerance = 0.002f)
+		: tolerance(tolerance)
+	{
+	}
+
+	// true, если траекторию пришлось перестроить
+	bool update(float newRadiusX, float newRadiusZ)
+	{
+		if (vertices.vertexCount() > 0 && newRadiusX == radiusX && newRadiusZ == radiusZ) return false;
+		radiusX = newRadiusX;
+		radiusZ = newRadiusZ;
+
+		int segmentTotal = segmentCount(std::max(radiusX, radiusZ));
+		std::vector<float> positions;
+		positions.reserve(segmentTotal * 3);
+		const float step = 2.0f * 3.14159265358979323846f / segmentTotal;
+		for (int i = 0; i < segmentTotal; i++)
+		{
+			float theta = i * step;
+			positions.push_back(radiusX * std::cos(theta)); // Радиус по оси X
+			positions.push_back(0.0f);
+			positions.push_back(radiusZ * std::sin(theta)); // Радиус по оси Z
+		}
+		vertices.upload(positions, GL_DYNAMIC_DRAW);
+		return true;
+	}
+
+	void draw() const { vertices.draw(GL_LINE_LOOP); }
+
+	int segments() const { return vertices.vertexCount(); }
+
+private:
+	// отклонение хорды от окружности радиуса r при n отрезках: r * (1 - cos(pi / n))
+	int segmentCount(float radius) const
+	{
+		const int minSegments = 16;
+		const int maxSegments = 1024;
+		if (radius <= tolerance) return minSegments;
+		double maxAngle = std::acos(1.0 - tolerance / radius); // половина угла одного отрезка
+		int segments = static_cast<int>(std::ceil(3.14159265358979323846 / maxAngle));
+		return std::min(std::max(segments, minSegments), maxSegments);
+	}
+
+	float tolerance;
+	float radiusX = 0.0f;
+	float radiusZ = 0.0f;
+	VertexBufferObject vertices;
+};
@@ -0,0 +1,200 @@
+// отсечение копий по пирамиде видимости камеры и по конусу прожектора (SSE2, по четыре копии за раз)
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "../common/vector_math.hpp"
+#include "../common/worker_pool.hpp"
+#include "instancing.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CULLING_USE_SSE2 1
+#endif
+
+// Шесть плоскостей пирамиды видимости (ax + by + cz + d >= 0 внутри), нормали единичные,
+// поэтому расстояние до плоскости сравнивается прямо с радиусом сферы
+struct Frustum
+{
+	float planes[6][4];
+
+	// метод Gribb/Hartmann: плоскости - суммы и разности строк матрицы projection * view (* model)
+	static Frustum fromMatrix(const Mat4& m)
+	{
+		Frustum frustum;
+		for (int i = 0; i < 6; ++i)
+		{
+			int row = i / 2;
+			float sign = i % 2 == 0 ? 1.0f : -1.0f;
+			float plane[4];
+			for (int column = 0; column < 4; ++column) plane[column] = m.columns[column].w + sign * m.columns[column].data()[row];
+			float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+			for (int k = 0; k < 4; ++k) frustum.planes[i][k] = plane[k] / length;
+		}
+		return frustum;
+	}
+};
+
+// Конус прожектора, как его считает фрагментный шейдер L4: theta = dot(normalize(lightPos - fragPos), normalize(lightDir)),
+// intensity = clamp((theta - outerCutoff) / (outerCutoff - cutoff)). Знаменатель отрицательный, поэтому intensity = 0
+// (а с ней и весь цвет, включая фоновый) при theta >= outerCutoff - внутри конуса с вершиной в источнике вдоль -lightDir
+struct SpotCone
+{
+	Vec3 apex;
+	Vec3 axis;  // единичная ось конуса от вершины (это -lightDir)
+	float cosAngle;
+	float sinAngle;
+
+	static SpotCone fromLight(const Vec3& lightPos, const Vec3& lightDir, float outerCutoff)
+	{
+		SpotCone cone;
+		cone.apex = lightPos;
+		cone.axis = -normalize(lightDir);
+		cone.cosAngle = outerCutoff;
+		cone.sinAngle = std::sqrt(std::max(0.0f, 1.0f - outerCutoff * outerCutoff));
+		return cone;
+	}
+};
+
+// Отсечение копий. Каждая копия - сфера радиусом scale * meshRadius вокруг своего положения.
+// На выходе видимые копии подряд: сначала те, которым нужно освещение, за ними - целиком лежащие в темной
+// части конуса прожектора (их достаточно закрасить черным без расчета света). Большие наборы делятся между потоками
+class InstanceCuller
+{
+public:
+	explicit InstanceCuller(float meshRadius)
+		: meshRadius(meshRadius)
+	{
+	}
+
+	// visible - результат, возвращается число копий с освещением (они в начале visible)
+	size_t cull(const std::vector<MeshInstance>& instances, const Frustum& frustum, const SpotCone& cone,
+		std::vector<MeshInstance>& visible)
+	{
+		size_t count = instances.size();
+		lit.resize(count);
+		unlit.resize(count);
+
+		// части делятся между потоками общего пула (потоки не создаются на каждый кадр)
+		WorkerPool& pool = WorkerPool::shared();
+		size_t threadCount = std::min<size_t>(pool.threadCount(), count / PARALLEL_CHUNK + 1);
+		size_t chunk = (count / threadCount + 3) & ~static_cast<size_t>(3);
+		litCounts.assign(threadCount, 0);
+		unlitCounts.assign(threadCount, 0);
+
+		auto cullPart = [&](int part)
+		{
+			size_t t = static_cast<size_t>(part);
+			cullRange(instances, frustum, cone, std::min(count, t * chunk),
+				t + 1 == threadCount ? count : std::min(count, (t + 1) * chunk), litCounts[t], unlitCounts[t]);
+		};
+		if (threadCount > 1) pool.run(static_cast<int>(threadCount), cullPart);
+		else cullPart(0);
+
+		// каждая часть записана на своем месте массивов, собираем части подряд
+		size_t litTotal = 0, unlitTotal = 0;
+		for (size_t t = 0; t < threadCount; ++t)
+		{
+			size_t begin = std::min(count, t * chunk);
+			std::memmove(&lit[litTotal], &lit[begin], litCounts[t] * sizeof(MeshInstance));
+			std::memmove(&unlit[unlitTotal], &unlit[begin], unlitCounts[t] * sizeof(MeshInstance));
+			litTotal += litCounts[t];
+			unlitTotal += unlitCounts[t];
+		}
+		visible.assign(lit.begin(), lit.begin() + litTotal);
+		visible.insert(visible.end(), unlit.begin(), unlit.begin() + unlitTotal);
+		return litTotal;
+	}
+
+private:
+	static constexpr size_t PARALLEL_CHUNK = 1 << 15; // меньше этого на поток делить работу невыгодно
+
+	// Сфера целиком внутри конуса, если расстояние от центра до боковой поверхности не меньше радиуса.
+	// Для центра на расстоянии along вдоль оси и perpendicular от нее это расстояние along * sin - perpendicular * cos
+	// (отрицательное - центр снаружи), так что обходимся без тригонометрии
+	static bool sphereInsideCone(float x, float y, float z, float radius, const SpotCone& cone)
+	{
+		float dx = x - cone.apex.x, dy = y - cone.apex.y, dz = z - cone.apex.z;
+		float alongAxis = dx * cone.axis.x + dy * cone.axis.y + dz * cone.axis.z;
+		float perpendicular = std::sqrt(std::max(0.0f, dx * dx + dy * dy + dz * dz - alongAxis * alongAxis));
+		return alongAxis * cone.sinAngle - perpendicular * cone.cosAngle >= radius;
+	}
+
+	void cullRange(const std::vector<MeshInstance>& instances, const Frustum& frustum, const SpotCone& cone,
+		size_t begin, size_t end, size_t& litCount, size_t& unlitCount)
+	{
+		MeshInstance* litOut = lit.data() + begin;
+		MeshInstance* unlitOut = unlit.data() + begin;
+		size_t i = begin;
+#ifdef CULLING_USE_SSE2
+		__m128 planes[6][4];
+		for (int p = 0; p < 6; ++p)
+			for (int k = 0; k < 4; ++k) planes[p][k] = _mm_set1_ps(frustum.planes[p][k]);
+		const __m128 radiusScale = _mm_set1_ps(meshRadius);
+		const __m128 apexX = _mm_set1_ps(cone.apex.x), apexY = _mm_set1_ps(cone.apex.y), apexZ = _mm_set1_ps(cone.apex.z);
+		const __m128 axisX = _mm_set1_ps(cone.axis.x), axisY = _mm_set1_ps(cone.axis.y), axisZ = _mm_set1_ps(cone.axis.z);
+		const __m128 coneCos = _mm_set1_ps(cone.cosAngle), coneSin = _mm_set1_ps(cone.sinAngle), zero = _mm_setzero_ps();
+		for (; i + 4 <= end; i += 4)
+		{
+			// четыре копии (x, y, z, scale) -> x, y, z и радиусы четырех копий
+			const float* source = &instances[i].position.x;
+			__m128 row0 = _mm_loadu_ps(source), row1 = _mm_loadu_ps(source + 4), row2 = _mm_loadu_ps(source + 8), row3 = _mm_loadu_ps(source + 12);
+			__m128 x = row0, y = row1, z = row2, radius = row3;
+			_MM_TRANSPOSE4_PS(x, y, z, radius);
+			radius = _mm_mul_ps(radius, radiusScale);
+
+			// сфера видна, если ни одна плоскость не оставляет ее целиком снаружи: distance >= -radius
+			__m128 negativeRadius = _mm_sub_ps(zero, radius);
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int p = 0; p < 6; ++p)
+			{
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, planes[p][0]), _mm_mul_ps(y, planes[p][1])),
+					_mm_add_ps(_mm_mul_ps(z, planes[p][2]), planes[p][3]));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+			}
+			int visibleMask = _mm_movemask_ps(inside);
+			if (visibleMask == 0) continue;
+
+			// тот же тест конуса, что и sphereInsideCone, для четырех сфер
+			__m128 dx = _mm_sub_ps(x, apexX), dy = _mm_sub_ps(y, apexY), dz = _mm_sub_ps(z, apexZ);
+			__m128 alongAxis = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, axisX), _mm_mul_ps(dy, axisY)), _mm_mul_ps(dz, axisZ));
+			__m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+			__m128 perpendicular = _mm_sqrt_ps(_mm_max_ps(zero, _mm_sub_ps(distanceSquared, _mm_mul_ps(alongAxis, alongAxis))));
+			__m128 surfaceDistance = _mm_sub_ps(_mm_mul_ps(alongAxis, coneSin), _mm_mul_ps(perpendicular, coneCos));
+			int darkMask = _mm_movemask_ps(_mm_cmpge_ps(surfaceDistance, radius)) & visibleMask;
+
+			const __m128 rows[4] = { row0, row1, row2, row3 };
+			for (int k = 0; k < 4; ++k)
+			{
+				if ((visibleMask & (1 << k)) == 0) continue;
+				MeshInstance* out = (darkMask & (1 << k)) != 0 ? unlitOut++ : litOut++;
+				_mm_storeu_ps(&out->position.x, rows[k]);
+			}
+		}
+#endif
+		for (; i < end; ++i)
+		{
+			const MeshInstance& instance = instances[i];
+			float radius = instance.scale * meshRadius;
+			bool inside = true;
+			for (int p = 0; p < 6 && inside; ++p)
+			{
+				const float* plane = frustum.planes[p];
+				inside = plane[0] * instance.position.x + plane[1] * instance.position.y + plane[2] * instance.position.z + plane[3] >= -radius;
+			}
+			if (!inside) continue;
+			if (sphereInsideCone(instance.position.x, instance.position.y, instance.position.z, radius, cone)) *unlitOut++ = instance;
+			else *litOut++ = instance;
+		}
+		litCount = litOut - (lit.data() + begin);
+		unlitCount = unlitOut - (unlit.data() + begin);
+	}
+
+	float meshRadius;
+	std::vector<MeshInstance> lit, unlit; // части потоков на местах их входных диапазонов
+	std::vector<size_t> litCounts, unlitCounts;
+};
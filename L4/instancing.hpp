@@ -0,0 +1,121 @@
+// множество копий сетки, нарисованных одним glDrawElementsInstanced
+
+#pragma once
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "../common/vector_math.hpp"
+#include "mesh.hpp"
+#include "stream_buffer.hpp"
+
+// Положение и размер одной копии. Нормали при равномерном масштабе не меняются,
+// поэтому матрица на копию не нужна: 16 байт вместо 64
+struct MeshInstance
+{
+	Vec3 position;
+	float scale;
+};
+
+static_assert(sizeof(MeshInstance) == 4 * sizeof(float), "MeshInstance is uploaded as one vec4");
+
+// Квадратная сетка копий на плоскости y = 0 перед камерой: сторона около 40 единиц при любом числе копий,
+// небольшой случайный сдвиг, чтобы ряды не сливались
+inline std::vector<MeshInstance> generateInstanceGrid(size_t count, unsigned seed = 1)
+{
+	std::vector<MeshInstance> instances(count);
+	if (count == 0) return instances;
+	const float fieldSize = 40.0f;
+	size_t side = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+	float spacing = fieldSize / side;
+	std::mt19937 generator(seed);
+	std::uniform_real_distribution<float> jitter(-0.2f * spacing, 0.2f * spacing);
+	for (size_t i = 0; i < count; ++i)
+	{
+		float column = static_cast<float>(i % side), row = static_cast<float>(i / side);
+		instances[i].position = Vec3((column + 0.5f) * spacing - fieldSize / 2.0f + jitter(generator), 0.0f,
+			5.0f - (row + 0.5f) * spacing + jitter(generator));
+		instances[i].scale = std::min(0.3f * spacing, 1.0f);
+	}
+	return instances;
+}
+
+// Плотный куб копий со стороной 6 единиц в центре сцены: в отличие от плоской сетки большая часть копий
+// закрыта передними слоями (сцена для проверки отсечения перекрытых копий)
+inline std::vector<MeshInstance> generateInstanceBlock(size_t count, unsigned seed = 1)
+{
+	std::vector<MeshInstance> instances(count);
+	if (count == 0) return instances;
+	const float blockSize = 6.0f;
+	size_t side = static_cast<size_t>(std::ceil(std::cbrt(static_cast<double>(count))));
+	float spacing = blockSize / side;
+	std::mt19937 generator(seed);
+	std::uniform_real_distribution<float> jitter(-0.05f * spacing, 0.05f * spacing);
+	for (size_t i = 0; i < count; ++i)
+	{
+		float column = static_cast<float>(i % side), row = static_cast<float>(i / side % side), layer = static_cast<float>(i / (side * side));
+		instances[i].position = Vec3((column + 0.5f) * spacing - blockSize / 2.0f + jitter(generator),
+			(layer + 0.5f) * spacing - blockSize / 2.0f + jitter(generator), blockSize / 2.0f - (row + 0.5f) * spacing + jitter(generator));
+		instances[i].scale = std::min(0.4f * spacing, 1.0f);
+	}
+	return instances;
+}
+
+// Копии кадра в кольцевом буфере, подключенные к VAO сетки как атрибут 2 (vec4: xyz - положение, w - размер)
+// с делителем 1. Каждый кадр копии пишутся заново в область кадра, и указатель атрибута переставляется на нее.
+// Если копии не рисуются, атрибут выключен и шейдер получает постоянное значение (0, 0, 0, 1) - одна сетка как есть
+class InstanceBuffer
+{
+public:
+	static const GLuint ATTRIBUTE = 2;
+
+	InstanceBuffer(const GpuMesh& mesh, StreamBuffer& stream)
+		: vertexArray(mesh.vao()), stream(stream)
+	{
+		glBindVertexArray(vertexArray);
+		glVertexAttribDivisor(ATTRIBUTE, 1);
+		glEnableVertexAttribArray(ATTRIBUTE);
+		glBindVertexArray(0);
+		setFirst(0);
+	}
+
+	InstanceBuffer(const InstanceBuffer&) = delete;
+	InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+
+	// копии, которые будут нарисованы в этом кадре; false, если в области кадра не хватило места
+	bool upload(const MeshInstance* instances, size_t count)
+	{
+		StreamBuffer::Allocation allocation = stream.allocate(count * sizeof(MeshInstance));
+		if (allocation.data == nullptr)
+		{
+			uploaded = 0;
+			return false;
+		}
+		if (count > 0) std::memcpy(allocation.data, instances, count * sizeof(MeshInstance));
+		base = allocation.offset;
+		uploaded = static_cast<GLsizei>(count);
+		return true;
+	}
+
+	GLsizei count() const { return uploaded; }
+
+	// следующий drawInstanced начнет с копии first (без glDrawElementsInstancedBaseInstance из OpenGL 4.2)
+	void setFirst(GLsizei first)
+	{
+		glBindVertexArray(vertexArray);
+		glBindBuffer(GL_ARRAY_BUFFER, stream.id());
+		glVertexAttribPointer(ATTRIBUTE, 4, GL_FLOAT, GL_FALSE, sizeof(MeshInstance), (GLvoid*)(base + first * sizeof(MeshInstance)));
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+private:
+	GLuint vertexArray;
+	StreamBuffer& stream;
+	GLintptr base = 0; // смещение копий кадра в кольцевом буфере
+	GLsizei uploaded = 0;
+};
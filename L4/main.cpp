@@ -2,191 +2,306 @@
 
 #include <SFML/Window.hpp>
 #include <GL/glew.h>
-#include <glm/glm.hpp>
-#include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/type_ptr.hpp>
+#include <chrono>
 #include <iostream>
 #include <vector>
 #include <cmath>
-
-#define M_PI 3.14159265358979323846
-
-// создание шейдера
-GLuint createShader(GLenum type, const char* source) {
-	GLuint shader = glCreateShader(type); // создаем объект шейдера указанного типа
-	glShaderSource(shader, 1, &source, nullptr); // связывает код шейдера с объектом (куда, сколько строк, откуда, длина строки)
-	glCompileShader(shader); // компиляция шейдера
-	return shader; // возвращаем id шейдера
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+
+#include "../common/async_log.hpp"
+#include "../common/gpu_timer.hpp"
+#include "../common/headless.hpp"
+#include "../common/microbench.hpp"
+#include "../common/vector_math.hpp"
+#include "culling.hpp"
+#include "instancing.hpp"
+#include "mesh.hpp"
+#include "occlusion.hpp"
+#include "shader_program.hpp"
+#include "spot_shading.hpp"
+#include "stream_buffer.hpp"
+
+// сетка выбранной фигуры с размерами прежнего цилиндра (радиус 1, высота 2)
+MeshData generateShape(const std::string& shape, int segments) {
+	if (shape == "cone") return mesh::cone(1.0f, 2.0f, segments);
+	if (shape == "sphere") return mesh::sphere(1.0f, segments, segments / 2);
+	if (shape == "box") return mesh::box(2.0f, 2.0f, 2.0f);
+	return mesh::cylinder(1.0f, 2.0f, segments);
 }
 
-// создание программы шейдеров, объединяет вершинный и фрагментный шейдеры в одну шейдерную программу
-GLuint createShaderProgram(const char* vertexShaderSource, const char* fragmentShaderSource) {
-	GLuint vertexShader = createShader(GL_VERTEX_SHADER, vertexShaderSource); // создание вершинного и фрагментного шейдера
-	GLuint fragmentShader = createShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
+// Заслон для отсечения закрытых копий: та же фигура не больше чем с 8 сегментами, вписанная в сетку generateShape.
+// Вершины грубой сетки на окружности радиуса 1 выступали бы за точную: ее многоугольник из segments сторон
+// в середине стороны отстоит от оси только на cos(pi / segments). Поэтому радиус грубой сетки умножается на это
+// число, а у сферы еще и на такой же множитель по поясам (половина углового шага между поясами)
+MeshData generateOccluder(const std::string& shape, int segments) {
+	int coarse = std::min(segments, 8);
+	float inscribed = std::cos(mesh::PI_F / std::max(segments, 3));
+	if (shape == "cone") return mesh::cone(inscribed, 2.0f, coarse);
+	if (shape == "sphere") {
+		int stacks = std::max(segments / 2, 2); // как в generateShape и mesh::sphere
+		return mesh::sphere(inscribed * std::cos(mesh::PI_F / (2 * stacks)), coarse, coarse / 2);
+	}
+	if (shape == "box") return mesh::box(2.0f, 2.0f, 2.0f);
+	return mesh::cylinder(inscribed, 2.0f, coarse);
+}
 
-	GLuint shaderProgram = glCreateProgram(); // создаем шейдерную программу
-	glAttachShader(shaderProgram, vertexShader); // привязка шейдеров к программе
-	glAttachShader(shaderProgram, fragmentShader);
-	glLinkProgram(shaderProgram); // сборка программы
+// то же с порядком индексов, оптимизированным для кэша вершин
+MeshData createShape(const std::string& shape, int segments) {
+	MeshData shapeMesh = generateShape(shape, segments);
 
-	return shaderProgram; // возвращаем id
+	float missesBefore = mesh::averageCacheMissRatio(shapeMesh.indices, shapeMesh.vertexCount());
+	mesh::optimize(shapeMesh);
+	std::cout << "Mesh " << shape << ": " << shapeMesh.vertexCount() << " vertices, " << shapeMesh.triangleCount() << " triangles, "
+		<< "cache misses per triangle " << missesBefore << " -> " << mesh::averageCacheMissRatio(shapeMesh.indices, shapeMesh.vertexCount()) << std::endl;
+	return shapeMesh;
 }
 
-// создание цилиндра, создает массив вершин и индексов цилиндра, а затем настраивает VAO, VBO и EBO для использования OpenGL
-void setupCylinder(GLuint& VAO, GLuint& VBO, GLuint& EBO) {
-	// VAO (Vertex Array Object) - объект, который хранит состояние привязки атрибутов вершин
-	// VBO (Vertex Buffer Object) - буфер для хранения координат вершин
-	// EBO (Element Buffer Object) - буфер для хранения индексов, которые определяют треугольники
-	const int numSegments = 12;  // количество сегментов
-	const float radius = 1.0f;
-	const float height = 2.0f;
-
-	std::vector<GLfloat> vertices; // вершины
-	std::vector<GLuint> indices; // поверхность
-
-	// генерация вершин цилиндра
-	for (int i = 0; i < numSegments; i++) {
-		float angle = i * 2.0f * M_PI / numSegments;
-		float nextAngle = (i + 1) * 2.0f * M_PI / numSegments;
-
-		float x0 = radius * cos(angle);
-		float z0 = radius * sin(angle);
-		float x1 = radius * cos(nextAngle);
-		float z1 = radius * sin(nextAngle);
-
-		// для боковой грани
-		vertices.push_back(x0);
-		vertices.push_back(-height / 2.0f);
-		vertices.push_back(z0);
-
-		vertices.push_back(x1);
-		vertices.push_back(-height / 2.0f);
-		vertices.push_back(z1);
-
-		vertices.push_back(x0);
-		vertices.push_back(height / 2.0f);
-		vertices.push_back(z0);
-
-		vertices.push_back(x1);
-		vertices.push_back(height / 2.0f);
-		vertices.push_back(z1);
-	}
+// параметры прожектора и затухания при запуске
+LightBlock createLight() {
+	LightBlock light = {};
+	light.lightPos = Vec3(0.0f, 2.0f, 2.0f);
+	light.lightColor = Vec3(1.0f, 1.0f, 1.0f);
+	light.lightDir = Vec3(-1.0f, -1.0f, -1.0f);
+	light.cutoff = cos(radians(12.5f)); // для прожектора
+	light.outerCutoff = cos(radians(17.5f));
+	light.constant = 1.0f;
+	light.linear = 0.09f;
+	light.quadratic = 0.032f;
+	return light;
+}
 
-	// центры верхней и нижней граней
-	vertices.push_back(0.0f); // центр нижней грани
-	vertices.push_back(-height / 2.0f);
-	vertices.push_back(0.0f);
-
-	vertices.push_back(0.0f); // центр верхней грани
-	vertices.push_back(height / 2.0f);
-	vertices.push_back(0.0f);
-
-	// вершины для окружности нижней и верхней граней
-	for (int i = 0; i < numSegments; i++) {
-		float angle = i * 2.0f * M_PI / numSegments;
-		float x = radius * cos(angle);
-		float z = radius * sin(angle);
-
-		// нижняя грань
-		vertices.push_back(x);
-		vertices.push_back(-height / 2.0f);
-		vertices.push_back(z);
-
-		// верхняя грань
-		vertices.push_back(x);
-		vertices.push_back(height / 2.0f);
-		vertices.push_back(z);
+// Замер освещения на процессоре без окна. Фрагменты - вершины фигур плоской сетки копий (положения и нормали сцены).
+// Векторный расчет сверяется с построчным переводом шейдера, скорость - в фрагментах в секунду на одном и на всех потоках
+int runShadingBenchmark(const MeshData& shapeData, size_t fragmentCount) {
+	size_t vertexCount = shapeData.vertexCount();
+	std::vector<MeshInstance> grid = generateInstanceGrid(fragmentCount / vertexCount + 1);
+	FragmentBuffer fragments;
+	fragments.resize(fragmentCount);
+	for (size_t i = 0; i < fragmentCount; i++) {
+		const MeshInstance& instance = grid[i / vertexCount];
+		const float* vertex = &shapeData.vertices[(i % vertexCount) * MeshData::FLOATS_PER_VERTEX];
+		fragments.x[i] = vertex[0] * instance.scale + instance.position.x;
+		fragments.y[i] = vertex[1] * instance.scale + instance.position.y;
+		fragments.z[i] = vertex[2] * instance.scale + instance.position.z;
+		fragments.normalX[i] = vertex[3];
+		fragments.normalY[i] = vertex[4];
+		fragments.normalZ[i] = vertex[5];
 	}
 
-
-	// индексы для треугольников
-	for (int i = 0; i < numSegments; i++) {
-		int startIdx = i * 4;
-		indices.push_back(startIdx);
-		indices.push_back(startIdx + 1);
-		indices.push_back(startIdx + 2);
-
-		indices.push_back(startIdx + 1);
-		indices.push_back(startIdx + 3);
-		indices.push_back(startIdx + 2);
+	LightBlock light = createLight();
+	SpotlightShader shader(light);
+	ColorBuffer reference, colors;
+	reference.resize(fragmentCount);
+
+	// лучшее время из нескольких запусков, в миллисекундах
+	auto measure = [](auto&& run) {
+		double best = 1e30;
+		for (int attempt = 0; attempt < 5; attempt++) {
+			auto start = std::chrono::steady_clock::now();
+			run();
+			best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		}
+		return best;
+	};
+	double referenceTime = measure([&] {
+		for (size_t i = 0; i < fragmentCount; i++) {
+			Vec3 color = shadeSpotlight(light, Vec3(fragments.x[i], fragments.y[i], fragments.z[i]),
+				Vec3(fragments.normalX[i], fragments.normalY[i], fragments.normalZ[i]));
+			reference.r[i] = color.x;
+			reference.g[i] = color.y;
+			reference.b[i] = color.z;
+		}
+	});
+	double singleTime = measure([&] { shader.shade(fragments, colors, 1); });
+	double parallelTime = measure([&] { shader.shade(fragments, colors); });
+
+	float maxError = 0.0f;
+	size_t litFragments = 0;
+	for (size_t i = 0; i < fragmentCount; i++) {
+		maxError = std::max({ maxError, std::abs(colors.r[i] - reference.r[i]), std::abs(colors.g[i] - reference.g[i]), std::abs(colors.b[i] - reference.b[i]) });
+		if (reference.r[i] > 0.0f || reference.g[i] > 0.0f || reference.b[i] > 0.0f) litFragments++;
 	}
 
-	// индексы для нижней грани
-	for (int i = 0; i < numSegments; i++) {
-		int centerIdx = vertices.size() - 2 * numSegments - 2;
-		int currentIdx = i * 2;
-		int nextIdx = ((i + 1) % numSegments) * 2;
+	auto rate = [fragmentCount](double milliseconds) { return fragmentCount / (milliseconds * 1000.0); };
+	std::cout << "Fragments: " << fragmentCount << " (lit " << litFragments << "), pool threads: " << WorkerPool::shared().threadCount() << std::endl;
+	std::cout << "Reference: " << referenceTime << " ms, " << rate(referenceTime) << " Mfragments/s" << std::endl;
+	std::cout << "SIMD, 1 thread: " << singleTime << " ms, " << rate(singleTime) << " Mfragments/s" << std::endl;
+	std::cout << "SIMD, all threads: " << parallelTime << " ms, " << rate(parallelTime) << " Mfragments/s" << std::endl;
+	std::cout << "Max difference from reference: " << maxError << std::endl;
+	return 0;
+}
 
-		indices.push_back(centerIdx);
-		indices.push_back(currentIdx);
-		indices.push_back(nextIdx);
+// Замер функций на процессоре по отдельности: построение сеток всех фигур с segments сегментами, их оптимизация
+// и освещение случайных фрагментов (зерно фиксированное). optimize получает свежую копию сетки, копирование входит в замер
+int runKernelBenchmark(int segments, const std::string& filter) {
+	const size_t INPUTS = 1024; // степень двойки: номер входа - i & (INPUTS - 1)
+	MicroBenchmark bench(filter);
+	for (const char* shape : { "cylinder", "cone", "sphere", "box" }) {
+		MeshData shapeData = generateShape(shape, segments);
+		double vertices = static_cast<double>(shapeData.vertexCount());
+		bench.run(std::string("generateShape ") + shape, [&](size_t) {
+			keepResult(generateShape(shape, segments).vertices.data());
+		}, vertices);
+		bench.run(std::string("mesh::optimize ") + shape, [&](size_t) {
+			MeshData copy = shapeData;
+			mesh::optimize(copy);
+			keepResult(copy.indices.data());
+		}, vertices);
 	}
 
-	// индексы для верхней грани
-	for (int i = 0; i < numSegments; i++) {
-		int centerIdx = vertices.size() - numSegments - 1;
-		int currentIdx = i * 2 + 1;
-		int nextIdx = ((i + 1) % numSegments) * 2 + 1;
-
-		indices.push_back(centerIdx);
-		indices.push_back(nextIdx);
-		indices.push_back(currentIdx);
+	// фрагменты в области под прожектором, нормали - случайные направления
+	std::mt19937 generator(12345);
+	std::uniform_real_distribution<float> position(-3.0f, 3.0f);
+	std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+	FragmentBuffer fragments;
+	fragments.resize(INPUTS);
+	for (size_t i = 0; i < INPUTS; i++) {
+		fragments.x[i] = position(generator);
+		fragments.y[i] = position(generator) - 1.0f;
+		fragments.z[i] = position(generator);
+		fragments.normalX[i] = direction(generator);
+		fragments.normalY[i] = direction(generator);
+		fragments.normalZ[i] = direction(generator);
 	}
-
-
-	// создаем VAO, VBO и EBO
-	glGenVertexArrays(1, &VAO); // сколько и что
-	glGenBuffers(1, &VBO);
-	glGenBuffers(1, &EBO);
-
-	glBindVertexArray(VAO); // активирует VAO, чтобы последующие настройки атрибутов вершин и буферов были связаны с этим VAO
-
-	glBindBuffer(GL_ARRAY_BUFFER, VBO); // определяем текущий буффер
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), &vertices[0], GL_STATIC_DRAW); // загружаем в буффер размер данных, указатель на них и ключ (редко меняются данные)
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), &indices[0], GL_STATIC_DRAW); // аналогично
-
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0); // задаем формат хранения вершин - индекс, кол-во компонентов на вершину, тип данных, данные не нормализованные, размер вершины (шаг), смещение от начала буфера
-	glEnableVertexAttribArray(0); // активация того что выше (атрибут)
-
-	glBindBuffer(GL_ARRAY_BUFFER, 0); // отвязываем VBO и VAO через id (во избежание ошибок)
-	glBindVertexArray(0);
+	LightBlock light = createLight();
+	SpotlightShader shader(light);
+	ColorBuffer colors;
+	colors.resize(INPUTS);
+	bench.run("shadeSpotlight", [&](size_t i) {
+		size_t fragment = i & (INPUTS - 1);
+		keepResult(shadeSpotlight(light, Vec3(fragments.x[fragment], fragments.y[fragment], fragments.z[fragment]),
+			Vec3(fragments.normalX[fragment], fragments.normalY[fragment], fragments.normalZ[fragment])));
+	});
+	bench.run("SpotlightShader::shadeRange (1024 fragments)", [&](size_t) {
+		shader.shadeRange(fragments, colors, 0, INPUTS);
+		keepResult(colors.r.data());
+	}, static_cast<double>(INPUTS));
+	return 0;
 }
 
-int main() {
-	sf::Window window(sf::VideoMode(1200, 1000), "Projector with cylinder", sf::Style::Default, sf::ContextSettings{ 24 }); // сцена с глубиной
-	glewInit(); // активируем glew
+// Параметры запуска:
+//   --shape cylinder|cone|sphere|box - фигура под прожектором (по умолчанию цилиндр)
+//   --segments <n>       - число сегментов по окружности (по умолчанию 32)
+//   --instances <n>      - сетка из n фигур одним вызовом отрисовки вместо одной фигуры;
+//                          PageUp/PageDown удваивают/уменьшают вдвое число фигур, раз в 120 кадров выводится время кадра
+//   --layout grid|block  - копии плоской сеткой на полу (по умолчанию) или плотным кубом, где большая часть закрыта
+//   --no-cull            - рисовать все копии, без отсечения по пирамиде видимости и конусу прожектора
+//   --occluders <n>      - сколько самых крупных копий растеризовать на процессоре для отсечения закрытых ими копий
+//                          (по умолчанию 256, 0 - не отсекать закрытые)
+//   --shading-bench <n>  - без окна: освещение n фрагментов на процессоре (SSE2, все ядра) против построчного
+//                          перевода шейдера, время и расхождение
+//   --kernel-bench [фильтр] - без окна: замер построения сеток и освещения по отдельности (только с фильтром в имени)
+//   --profile [файл.csv] - замер времени этапов кадра (на видеокарте тоже, если есть таймеры OpenGL)
+//   --headless [кадры] [файл.ppm] - без окна (EGL): нарисовать кадры (по умолчанию 300), последний сохранить
+//                          (по умолчанию L4_frame.ppm) и вывести время кадров
+int main(int argc, char* argv[]) {
+	FrameProfiler::instance().configure(argc, argv);
+
+	std::string shape = "cylinder";
+	int segments = 32;
+	size_t instanceCount = 0; // 0 - одна фигура
+	bool culling = true;
+	size_t occluderCount = 256;
+	std::string layout = "grid";
+	size_t shadingFragments = 0;
+	bool kernelBench = false;
+	std::string kernelFilter;
+	for (int i = 1; i < argc; i++) {
+		std::string option = argv[i];
+		if (option == "--no-cull") culling = false;
+		else if (option == "--kernel-bench") {
+			kernelBench = true;
+			if (i + 1 < argc && argv[i + 1][0] != '-') kernelFilter = argv[++i];
+		}
+		else if (i + 1 >= argc) break;
+		else if (option == "--shape") shape = argv[++i];
+		else if (option == "--segments") segments = std::atoi(argv[++i]);
+		else if (option == "--instances") instanceCount = std::strtoul(argv[++i], nullptr, 10);
+		else if (option == "--layout") layout = argv[++i];
+		else if (option == "--occluders") occluderCount = std::strtoul(argv[++i], nullptr, 10);
+		else if (option == "--shading-bench") shadingFragments = std::strtoul(argv[++i], nullptr, 10);
+	}
+	if (shadingFragments > 0)
+		return runShadingBenchmark(generateShape(shape, segments), shadingFragments);
+	if (kernelBench)
+		return runKernelBenchmark(segments, kernelFilter);
+
+	HeadlessRenderer headless;
+	headless.configure(argc, argv, "L4_frame.ppm");
+	std::unique_ptr<sf::Window> window; // в режиме без окна кадры рисуются в кадровый буфер headless
+	if (headless.isEnabled()) {
+		if (!headless.create(1200, 1000))
+			return 1;
+	}
+	else {
+		window.reset(new sf::Window(sf::VideoMode(1200, 1000), "Projector with cylinder", sf::Style::Default, sf::ContextSettings{ 24 })); // сцена с глубиной
+		glewInit(); // активируем glew
+	}
 
-	GLuint VAO, VBO, EBO; // переменные для хранения инфы о вершинах и индексах цилиндра
-	setupCylinder(VAO, VBO, EBO); // создаем цилиндр
+	MeshData shapeData = createShape(shape, segments);
+	GpuMesh shapeMesh(shapeData); // вершины с нормалями и индексы на видеокарте
+
+	// Данные кадра (блоки uniform и копии) пишутся в кольцевой буфер из трех областей. Область под кадр:
+	// по блоку на выравнивание с запасом и все копии (после отсечения их не больше)
+	auto frameBytes = [](size_t instances) { return sizeof(CameraBlock) + sizeof(LightBlock) + 3 * 256 + instances * sizeof(MeshInstance); };
+	StreamBuffer frameStream(frameBytes(instanceCount));
+	std::cout << "Frame data: " << (frameStream.isPersistent() ? "persistently mapped" : "glBufferSubData") << " ring buffer, "
+		<< StreamBuffer::REGIONS << " x " << frameStream.capacity() << " bytes" << std::endl;
+
+	// положения и размеры копий; для одной фигуры атрибут копии постоянный: без сдвига, размер 1
+	std::unique_ptr<InstanceBuffer> instanceBuffer;
+	std::vector<MeshInstance> instances, visibleInstances;
+	InstanceCuller culler(mesh::boundingRadius(shapeData));
+	// заслоны - грубая сетка той же фигуры, вписанная в точную
+	OcclusionCuller occlusionCuller(generateOccluder(shape, segments), mesh::boundingHalfExtents(shapeData));
+	size_t litInstances = 0; // видимые копии, которым нужно освещение (в начале буфера), остальные - черные
+	if (instanceCount > 0) {
+		instanceBuffer.reset(new InstanceBuffer(shapeMesh, frameStream));
+		instances = layout == "block" ? generateInstanceBlock(instanceCount) : generateInstanceGrid(instanceCount);
+		litInstances = instances.size();
+	}
+	else {
+		glVertexAttrib4f(InstanceBuffer::ATTRIBUTE, 0.0f, 0.0f, 0.0f, 1.0f);
+	}
 
-	// шейдеры
+	// шейдеры (положение фигуры, параметры камеры и прожектора - в блоках uniform, общих для всех программ)
 	const char* vertexShaderSource = R"(
         #version 330 core
         layout(location = 0) in vec3 aPos;
-        uniform mat4 model;
-        uniform mat4 view;
-        uniform mat4 projection;
+        layout(location = 1) in vec3 aNormal;
+        layout(location = 2) in vec4 aInstance; // положение (xyz) и размер (w) копии
+        layout(std140) uniform Camera {
+            mat4 model;
+            mat4 view;
+            mat4 projection;
+            vec3 viewPos;
+        };
         out vec3 fragPos;  // Передача позиции фрагмента
+        out vec3 fragNormal; // Нормаль в мировых координатах
         void main() {
-            fragPos = vec3(model * vec4(aPos, 1.0f));  // Вычисление позиции фрагмента
+            fragPos = vec3(model * vec4(aPos * aInstance.w + aInstance.xyz, 1.0f));  // Вычисление позиции фрагмента
+            fragNormal = mat3(model) * aNormal;  // model только сдвигает и поворачивает, обратная транспонированная не нужна
             gl_Position = projection * view * vec4(fragPos, 1.0f);  // Преобразование в экранные координаты
         })";
 
 	const char* fragmentShaderSource = R"(
         #version 330 core
         out vec4 FragColor;
-        uniform vec3 lightPos;   // Позиция источника света
-        uniform vec3 lightDir;   // Направление света (для прожектора)
-        uniform vec3 viewPos;    // Позиция камеры
-        uniform vec3 lightColor; // Цвет света
-        uniform float cutoff;    // Угол конуса прожектора (косинус угла)
-        uniform float outerCutoff; // Внешний угол прожектора (косинус угла)
-        uniform float constant;  // Коэффициент затухания: постоянный
-        uniform float linear;    // Коэффициент затухания: линейный
-        uniform float quadratic; // Коэффициент затухания: квадратичный
+        layout(std140) uniform Light {
+            vec3 lightPos;     // Позиция источника света
+            float cutoff;      // Угол конуса прожектора (косинус угла)
+            vec3 lightDir;     // Направление света (для прожектора)
+            float outerCutoff; // Внешний угол прожектора (косинус угла)
+            vec3 lightColor;   // Цвет света
+            float constant;    // Коэффициент затухания: постоянный
+            float linear;      // Коэффициент затухания: линейный
+            float quadratic;   // Коэффициент затухания: квадратичный
+        };
         in vec3 fragPos;         // Позиция фрагмента, полученная из вершинного шейдера
+        in vec3 fragNormal;      // Нормаль поверхности
 
         void main() {
             vec3 lightDirToFrag = normalize(lightPos - fragPos);
@@ -198,143 +313,215 @@ int main() {
             float attenuation = 1.0f / (constant + linear * distance + quadratic * distance * distance);
 
             vec3 ambient = 0.1f * lightColor;
-            vec3 diffuse = max(dot(normalize(lightPos - fragPos), normalize(vec3(0.0f, 0.0f, 1.0f))), 0.0f) * lightColor;
+            vec3 diffuse = max(dot(lightDirToFrag, normalize(fragNormal)), 0.0f) * lightColor;
             vec3 result = (ambient + diffuse) * attenuation * intensity;
             FragColor = vec4(result, 1.0f);
         })";
 
-	GLuint shaderProgram = createShaderProgram(vertexShaderSource, fragmentShaderSource);
+	// для копий в темной части конуса прожектора свет не считается: шейдер выше дал бы для них ровно ноль
+	const char* darkFragmentShaderSource = R"(
+        #version 330 core
+        out vec4 FragColor;
+        void main() {
+            FragColor = vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        })";
 
-	// параметры освещения и камеры
-	glm::vec3 lightPos(0.0f, 2.0f, 2.0f);
-	glm::vec3 lightColor(1.0f, 1.0f, 1.0f);
-	glm::vec3 viewPos(0.0f, 2.0f, 10.0f);
-	glm::vec3 lightDir(-1.0f, -1.0f, -1.0f);
+	// собранная программа кэшируется в файле, при следующем запуске компиляция не нужна
+	ShaderProgram shaderProgram;
+	if (!shaderProgram.build(vertexShaderSource, fragmentShaderSource, "cylinder_program.bin"))
+		return 1;
+	if (shaderProgram.loadedFromCache())
+		std::cout << "Shader program loaded from cache" << std::endl;
+
+	const GLuint CAMERA_BINDING = 0, LIGHT_BINDING = 1;
+	shaderProgram.bindBlock("Camera", CAMERA_BINDING);
+	shaderProgram.bindBlock("Light", LIGHT_BINDING);
 
-	float cutoff = cos(glm::radians(12.5f)); // для прожектора
-	float outerCutoff = cos(glm::radians(17.5f));
+	ShaderProgram darkProgram;
+	if (!darkProgram.build(vertexShaderSource, darkFragmentShaderSource, "cylinder_dark_program.bin"))
+		return 1;
+	darkProgram.bindBlock("Camera", CAMERA_BINDING);
+
+	// параметры освещения и камеры
+	LightBlock light = createLight();
 
 	// коэффициенты затухания
-	float constant = 1.0f;
-	float linear = 0.09f;
-	float quadratic = 0.032f;
-
-	// передача параметров в шейдер
-	glUseProgram(shaderProgram); // активация созданных шейдеров
-	glUniform3fv(glGetUniformLocation(shaderProgram, "lightPos"), 1, glm::value_ptr(lightPos));
-	glUniform3fv(glGetUniformLocation(shaderProgram, "viewPos"), 1, glm::value_ptr(viewPos));
-	glUniform3fv(glGetUniformLocation(shaderProgram, "lightColor"), 1, glm::value_ptr(lightColor));
-	glUniform3fv(glGetUniformLocation(shaderProgram, "lightDir"), 1, glm::value_ptr(lightDir));
-	glUniform1f(glGetUniformLocation(shaderProgram, "cutoff"), cutoff);
-	glUniform1f(glGetUniformLocation(shaderProgram, "outerCutoff"), outerCutoff);
-	glUniform1f(glGetUniformLocation(shaderProgram, "constant"), constant);
-	glUniform1f(glGetUniformLocation(shaderProgram, "linear"), linear);
-	glUniform1f(glGetUniformLocation(shaderProgram, "quadratic"), quadratic);
+	float& constant = light.constant;
+	float& linear = light.linear;
+	float& quadratic = light.quadratic;
+
+	CameraBlock camera = {};
+	camera.viewPos = Vec3(0.0f, 2.0f, 10.0f);
+
+	shaderProgram.use(); // активация созданных шейдеров
 
 	// текущая позиция цилиндра
-	glm::vec3 cylinderPosition(0.0f, 0.0f, 0.0f);
+	Vec3 cylinderPosition(0.0f, 0.0f, 0.0f);
 
 	glEnable(GL_DEPTH_TEST); // включили тест глубины
 
-	while (window.isOpen()) {
+	GpuStageTimer gpuDrawTimer("draw"); // время отрисовки на видеокарте
+
+	sf::Clock frameClock; // среднее время кадра для режима с копиями
+	double frameTimeSum = 0.0;
+	int statFrames = 0;
+
+	while (window ? window->isOpen() : headless.isOpen()) {
+		PROFILE_BEGIN(inputTimer, "input");
 		sf::Event event;
-		while (window.pollEvent(event)) {
+		while (window && window->pollEvent(event)) {
 			if (event.type == sf::Event::Closed)
-				window.close();
+				window->close();
 
 			if (event.type == sf::Event::KeyPressed) {
 				// обработка нажатий клавиш для изменения параметров затухания
 				if (event.key.code == sf::Keyboard::Up) {
 					quadratic += 0.01f;
 					if (quadratic < 0.0f) quadratic = 0.0f;  
-					std::cout << "Quadratic attenuation increased: " << quadratic << std::endl;
+					AsyncLog::instance().write("Quadratic attenuation increased: {}", quadratic);
 				}
 				if (event.key.code == sf::Keyboard::Down) {
 					quadratic -= 0.01f;
 					if (quadratic < 0.0f) quadratic = 0.0f;  
-					std::cout << "Quadratic attenuation decreased: " << quadratic << std::endl;
+					AsyncLog::instance().write("Quadratic attenuation decreased: {}", quadratic);
 				}
 				if (event.key.code == sf::Keyboard::Right) {
 					linear += 0.01f;
 					if (linear < 0.0f) linear = 0.0f;  
-					std::cout << "Linear attenuation increased: " << linear << std::endl;
+					AsyncLog::instance().write("Linear attenuation increased: {}", linear);
 				}
 				if (event.key.code == sf::Keyboard::Left) {
 					linear -= 0.01f;
 					if (linear < 0.0f) linear = 0.0f;  
-					std::cout << "Linear attenuation decreased: " << linear << std::endl;
+					AsyncLog::instance().write("Linear attenuation decreased: {}", linear);
 				}
 				if (event.key.code == sf::Keyboard::Equal) {
 					constant += 0.01f;
 					if (constant < 0.0f) constant = 0.0f;  
-					std::cout << "Constant attenuation increased: " << constant << std::endl;
+					AsyncLog::instance().write("Constant attenuation increased: {}", constant);
+				}
+				if (instanceBuffer && (event.key.code == sf::Keyboard::PageUp || event.key.code == sf::Keyboard::PageDown)) {
+					instanceCount = event.key.code == sf::Keyboard::PageUp ? instanceCount * 2 : std::max<size_t>(instanceCount / 2, 1);
+					instances = layout == "block" ? generateInstanceBlock(instanceCount) : generateInstanceGrid(instanceCount);
+					litInstances = instances.size();
+					frameTimeSum = 0.0;
+					statFrames = 0;
 				}
 				if (event.key.code == sf::Keyboard::Dash) {
 					constant -= 0.1f;
 					if (constant < 0.0f) constant = 0.0f; 
-					std::cout << "Constant attenuation decreased: " << constant << std::endl;
+					AsyncLog::instance().write("Constant attenuation decreased: {}", constant);
 				}
-
-				glUniform1f(glGetUniformLocation(shaderProgram, "constant"), constant); // обновляем параметры
-				glUniform1f(glGetUniformLocation(shaderProgram, "linear"), linear);
-				glUniform1f(glGetUniformLocation(shaderProgram, "quadratic"), quadratic);
 			}
 		}
 
-		// Управление движением цилиндра
-		if (sf::Keyboard::isKeyPressed(sf::Keyboard::W)) {
+		// Управление движением цилиндра (без окна клавиатура не опрашивается)
+		if (window && sf::Keyboard::isKeyPressed(sf::Keyboard::W)) {
 			cylinderPosition.y += 0.01f;
-			std::cout << "Cylinder moved up: " << cylinderPosition.y << std::endl;
+			AsyncLog::instance().write("Cylinder moved up: {}", cylinderPosition.y);
 		}
-		if (sf::Keyboard::isKeyPressed(sf::Keyboard::S)) {
+		if (window && sf::Keyboard::isKeyPressed(sf::Keyboard::S)) {
 			cylinderPosition.y -= 0.01f;
-			std::cout << "Cylinder moved down: " << cylinderPosition.y << std::endl;
+			AsyncLog::instance().write("Cylinder moved down: {}", cylinderPosition.y);
 		}
-		if (sf::Keyboard::isKeyPressed(sf::Keyboard::A)) {
+		if (window && sf::Keyboard::isKeyPressed(sf::Keyboard::A)) {
 			cylinderPosition.x -= 0.01f;
-			std::cout << "Cylinder moved left: " << cylinderPosition.x << std::endl;
+			AsyncLog::instance().write("Cylinder moved left: {}", cylinderPosition.x);
 		}
-		if (sf::Keyboard::isKeyPressed(sf::Keyboard::D)) {
+		if (window && sf::Keyboard::isKeyPressed(sf::Keyboard::D)) {
 			cylinderPosition.x += 0.01f;
-			std::cout << "Cylinder moved right: " << cylinderPosition.x << std::endl;
+			AsyncLog::instance().write("Cylinder moved right: {}", cylinderPosition.x);
 		}
-		if (sf::Keyboard::isKeyPressed(sf::Keyboard::Q)) {
+		if (window && sf::Keyboard::isKeyPressed(sf::Keyboard::Q)) {
 			cylinderPosition.z -= 0.01f;
-			std::cout << "Cylinder moved backward: " << cylinderPosition.z << std::endl;
+			AsyncLog::instance().write("Cylinder moved backward: {}", cylinderPosition.z);
 		}
-		if (sf::Keyboard::isKeyPressed(sf::Keyboard::E)) {
+		if (window && sf::Keyboard::isKeyPressed(sf::Keyboard::E)) {
 			cylinderPosition.z += 0.01f;
-			std::cout << "Cylinder moved forward: " << cylinderPosition.z << std::endl;
+			AsyncLog::instance().write("Cylinder moved forward: {}", cylinderPosition.z);
 		}
+		inputTimer.stop();
 
 		// создаем матрицы для преобразований
-		glm::mat4 model = glm::translate(glm::mat4(1.0f), cylinderPosition); // исходник и как меняем
+		PROFILE_BEGIN(updateTimer, "update");
+		camera.model = Mat4::translation(cylinderPosition); // исходник и как меняем
 		// обновляем элементы сцены через матричные преобразования
-		glm::mat4 view = glm::lookAt(viewPos, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f)); // 4х4 откуда, куда, где верх камеры
-		glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1200.0f / 1000.0f, 0.1f, 100.0f); // угол обзора, соотношение сторон, не видно близко и не видно далеко
-
-		// передаем изменения в шейдер
-		glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model)); // локация переменной, сколько, надо ли транспонировать, матрица
-		glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
-		glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+		camera.view = Mat4::lookAt(camera.viewPos, Vec3(0.0f, 0.0f, 0.0f), Vec3(0.0f, 1.0f, 0.0f)); // 4х4 откуда, куда, где верх камеры
+		camera.projection = Mat4::perspective(45.0f, 1200.0f / 1000.0f, 0.1f, 100.0f); // угол обзора, соотношение сторон, не видно близко и не видно далеко
+
+		// блоки uniform пишутся прямо в область кадра, без glUniform* и glBufferSubData
+		frameStream.reserve(frameBytes(instances.size()));
+		frameStream.beginFrame();
+		frameStream.writeUniform(CAMERA_BINDING, camera);
+		frameStream.writeUniform(LIGHT_BINDING, light);
+		updateTimer.stop();
+
+		// копии вне пирамиды видимости и закрытые ближними копиями не рисуются, копии в темной части конуса
+		// прожектора рисуются без света. model только сдвигает сцену, поэтому пирамида и конус переводятся в координаты копий.
+		// Копии тоже пишутся заново каждый кадр: область кадра через три кадра займет другой кадр
+		if (instanceBuffer && culling) {
+			PROFILE_BEGIN(cullTimer, "cull");
+			Mat4 transform = camera.projection * camera.view * camera.model;
+			Frustum frustum = Frustum::fromMatrix(transform);
+			SpotCone cone = SpotCone::fromLight(light.lightPos - cylinderPosition, light.lightDir, light.outerCutoff);
+			litInstances = culler.cull(instances, frustum, cone, visibleInstances);
+			cullTimer.stop();
+			if (occluderCount > 0) {
+				PROFILE_SCOPE("occlusion");
+				litInstances = occlusionCuller.cull(visibleInstances, litInstances, transform, occluderCount);
+			}
+			instanceBuffer->upload(visibleInstances.data(), visibleInstances.size());
+		}
+		else if (instanceBuffer) {
+			instanceBuffer->upload(instances.data(), instances.size());
+		}
+		frameStream.flush();
 
 		// очистка экрана
+		PROFILE_BEGIN(drawTimer, "draw");
+		gpuDrawTimer.begin();
 		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		// рендеринг цилиндра
-		glUseProgram(shaderProgram);
-		glBindVertexArray(VAO);
-		glDrawElements(GL_TRIANGLES, 72, GL_UNSIGNED_INT, 0); // из чего, индексы, формат и смещение
-
-		window.display();
+		// рендеринг цилиндра (или всех копий сразу)
+		shaderProgram.use();
+		if (instanceBuffer) {
+			GLsizei darkInstances = instanceBuffer->count() - static_cast<GLsizei>(litInstances);
+			instanceBuffer->setFirst(0);
+			shapeMesh.drawInstanced(static_cast<GLsizei>(litInstances));
+			if (darkInstances > 0) {
+				darkProgram.use();
+				instanceBuffer->setFirst(static_cast<GLsizei>(litInstances));
+				shapeMesh.drawInstanced(darkInstances);
+			}
+		}
+		else
+			shapeMesh.draw(); // число и формат индексов берутся из самой сетки
+		gpuDrawTimer.end();
+		frameStream.endFrame(); // область кадра снова можно писать, когда видеокарта дойдет до этого места
+		drawTimer.stop();
+
+		PROFILE_BEGIN(displayTimer, "display");
+		if (window)
+			window->display();
+		else
+			headless.display();
+		displayTimer.stop();
+		FrameProfiler::instance().endFrame();
+
+		frameTimeSum += frameClock.restart().asSeconds() * 1000.0;
+		if (instanceBuffer && ++statFrames >= 120) {
+			AsyncLog::instance().write("Instances: {}, drawn {} (lit {}), frame {} ms", instances.size(), instanceBuffer->count(), litInstances, frameTimeSum / statFrames);
+			if (culling && occluderCount > 0)
+				AsyncLog::instance().write("Occlusion: {} occluders hid {} instances", occlusionCuller.occluderCount(), occlusionCuller.hiddenCount());
+			AsyncLog::instance().write("Frame data: {} of {} bytes, waited for GPU {} times", frameStream.usedBytes(), frameStream.capacity(), frameStream.waitCount());
+			frameTimeSum = 0.0;
+			statFrames = 0;
+		}
 	}
+	bool saved = !headless.isEnabled() || headless.finish(); // последний кадр без окна - в файл
+	AsyncLog::instance().flush(); // последние сообщения до итоговой сводки
+	FrameProfiler::instance().finish();
 
-	// избавляемся от утечек памяти
-	glDeleteVertexArrays(1, &VAO);
-	glDeleteBuffers(1, &VBO);
-	glDeleteBuffers(1, &EBO);
-	glDeleteProgram(shaderProgram);
-
-	return 0;
+	return saved ? 0 : 1;
 }
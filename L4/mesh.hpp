@@ -0,0 +1,441 @@
+// параметрические сетки (цилиндр, конус, сфера, коробка) с нормалями, общими вершинами и оптимизацией порядка индексов
+
+#pragma once
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "../common/vector_math.hpp"
+
+// Вершины лежат подряд: x, y, z, nx, ny, nz. Вершины с одинаковыми позицией и нормалью не дублируются,
+// отдельные копии есть только на ребрах, где нормаль меняется скачком (край крышки цилиндра, ребра коробки)
+struct MeshData
+{
+	static constexpr int FLOATS_PER_VERTEX = 6;
+
+	std::vector<float> vertices;
+	std::vector<std::uint32_t> indices; // треугольники, обход против часовой стрелки снаружи
+
+	size_t vertexCount() const { return vertices.size() / FLOATS_PER_VERTEX; }
+	size_t triangleCount() const { return indices.size() / 3; }
+
+	std::uint32_t addVertex(float x, float y, float z, float nx, float ny, float nz)
+	{
+		vertices.insert(vertices.end(), { x, y, z, nx, ny, nz });
+		return static_cast<std::uint32_t>(vertexCount() - 1);
+	}
+
+	void addTriangle(std::uint32_t a, std::uint32_t b, std::uint32_t c)
+	{
+		indices.insert(indices.end(), { a, b, c });
+	}
+};
+
+namespace mesh
+{
+	const float PI_F = 3.14159265358979323846f;
+
+	// крышка из веера треугольников вокруг центра; ring - первая вершина кольца из segments вершин
+	inline void addCap(MeshData& mesh, float radius, float y, int segments, bool facingUp)
+	{
+		float normalY = facingUp ? 1.0f : -1.0f;
+		std::uint32_t center = mesh.addVertex(0.0f, y, 0.0f, 0.0f, normalY, 0.0f);
+		std::uint32_t ring = static_cast<std::uint32_t>(mesh.vertexCount());
+		for (int i = 0; i < segments; ++i)
+		{
+			float angle = i * 2.0f * PI_F / segments;
+			mesh.addVertex(radius * std::cos(angle), y, radius * std::sin(angle), 0.0f, normalY, 0.0f);
+		}
+		for (int i = 0; i < segments; ++i)
+		{
+			std::uint32_t current = ring + i;
+			std::uint32_t next = ring + (i + 1) % segments;
+			if (facingUp) mesh.addTriangle(center, next, current);
+			else mesh.addTriangle(center, current, next);
+		}
+	}
+
+	// цилиндр вдоль оси Y с центром в начале координат; rings - число поясов по высоте
+	inline MeshData cylinder(float radius, float height, int segments, int rings = 1)
+	{
+		segments = std::max(segments, 3);
+		rings = std::max(rings, 1);
+		MeshData mesh;
+		for (int ring = 0; ring <= rings; ++ring)
+		{
+			float y = -height / 2.0f + height * ring / rings;
+			for (int i = 0; i < segments; ++i)
+			{
+				float angle = i * 2.0f * PI_F / segments;
+				float nx = std::cos(angle), nz = std::sin(angle);
+				mesh.addVertex(radius * nx, y, radius * nz, nx, 0.0f, nz);
+			}
+		}
+		for (int ring = 0; ring < rings; ++ring)
+		{
+			for (int i = 0; i < segments; ++i)
+			{
+				std::uint32_t bottom = ring * segments + i;
+				std::uint32_t bottomNext = ring * segments + (i + 1) % segments;
+				mesh.addTriangle(bottom, bottom + segments, bottomNext);
+				mesh.addTriangle(bottomNext, bottom + segments, bottomNext + segments);
+			}
+		}
+		addCap(mesh, radius, -height / 2.0f, segments, false);
+		addCap(mesh, radius, height / 2.0f, segments, true);
+		return mesh;
+	}
+
+	// конус вдоль оси Y: основание внизу, вершина наверху. У вершины конуса своя копия на каждый сегмент,
+	// иначе одна общая нормаль смазала бы освещение всей боковой поверхности
+	inline MeshData cone(float radius, float height, int segments)
+	{
+		segments = std::max(segments, 3);
+		MeshData mesh;
+		float slope = radius / height; // нормаль боковой поверхности наклонена вверх на этот тангенс
+		float normalScale = 1.0f / std::sqrt(1.0f + slope * slope);
+		for (int i = 0; i < segments; ++i)
+		{
+			float angle = i * 2.0f * PI_F / segments;
+			mesh.addVertex(radius * std::cos(angle), -height / 2.0f, radius * std::sin(angle),
+				std::cos(angle) * normalScale, slope * normalScale, std::sin(angle) * normalScale);
+		}
+		for (int i = 0; i < segments; ++i)
+		{
+			float angle = (i + 0.5f) * 2.0f * PI_F / segments;
+			std::uint32_t apex = mesh.addVertex(0.0f, height / 2.0f, 0.0f,
+				std::cos(angle) * normalScale, slope * normalScale, std::sin(angle) * normalScale);
+			mesh.addTriangle(i, apex, (i + 1) % segments);
+		}
+		addCap(mesh, radius, -height / 2.0f, segments, false);
+		return mesh;
+	}
+
+	// сфера из slices меридианов и stacks поясов, полюса - по одной вершине
+	inline MeshData sphere(float radius, int slices, int stacks)
+	{
+		slices = std::max(slices, 3);
+		stacks = std::max(stacks, 2);
+		MeshData mesh;
+		std::uint32_t bottomPole = mesh.addVertex(0.0f, -radius, 0.0f, 0.0f, -1.0f, 0.0f);
+		for (int stack = 1; stack < stacks; ++stack)
+		{
+			float polar = PI_F * stack / stacks;
+			float ringY = -std::cos(polar), ringRadius = std::sin(polar);
+			for (int i = 0; i < slices; ++i)
+			{
+				float angle = i * 2.0f * PI_F / slices;
+				float nx = ringRadius * std::cos(angle), nz = ringRadius * std::sin(angle);
+				mesh.addVertex(radius * nx, radius * ringY, radius * nz, nx, ringY, nz);
+			}
+		}
+		std::uint32_t topPole = mesh.addVertex(0.0f, radius, 0.0f, 0.0f, 1.0f, 0.0f);
+
+		auto ringVertex = [slices](int ring, int i) { return static_cast<std::uint32_t>(1 + ring * slices + (i % slices)); };
+		for (int i = 0; i < slices; ++i)
+		{
+			mesh.addTriangle(bottomPole, ringVertex(0, i), ringVertex(0, i + 1));
+			mesh.addTriangle(topPole, ringVertex(stacks - 2, i + 1), ringVertex(stacks - 2, i));
+		}
+		for (int ring = 0; ring + 1 < stacks - 1; ++ring)
+		{
+			for (int i = 0; i < slices; ++i)
+			{
+				mesh.addTriangle(ringVertex(ring, i), ringVertex(ring + 1, i), ringVertex(ring, i + 1));
+				mesh.addTriangle(ringVertex(ring, i + 1), ringVertex(ring + 1, i), ringVertex(ring + 1, i + 1));
+			}
+		}
+		return mesh;
+	}
+
+	// коробка с центром в начале координат, у каждой грани свои 4 вершины
+	inline MeshData box(float width, float height, float depth)
+	{
+		MeshData mesh;
+		const float half[3] = { width / 2.0f, height / 2.0f, depth / 2.0f };
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			for (int side = -1; side <= 1; side += 2)
+			{
+				// u и v - две другие оси, порядок выбран так, чтобы u x v смотрел наружу
+				int u = (axis + (side > 0 ? 1 : 2)) % 3;
+				int v = (axis + (side > 0 ? 2 : 1)) % 3;
+				std::uint32_t first = static_cast<std::uint32_t>(mesh.vertexCount());
+				for (int corner = 0; corner < 4; ++corner)
+				{
+					float position[3], normal[3] = { 0.0f, 0.0f, 0.0f };
+					position[axis] = side * half[axis];
+					position[u] = (corner == 1 || corner == 2 ? 1.0f : -1.0f) * half[u];
+					position[v] = (corner >= 2 ? 1.0f : -1.0f) * half[v];
+					normal[axis] = static_cast<float>(side);
+					mesh.addVertex(position[0], position[1], position[2], normal[0], normal[1], normal[2]);
+				}
+				mesh.addTriangle(first, first + 1, first + 2);
+				mesh.addTriangle(first, first + 2, first + 3);
+			}
+		}
+		return mesh;
+	}
+
+	// радиус сферы с центром в начале координат, в которую помещается вся сетка
+	inline float boundingRadius(const MeshData& mesh)
+	{
+		float radiusSquared = 0.0f;
+		for (size_t i = 0; i < mesh.vertices.size(); i += MeshData::FLOATS_PER_VERTEX)
+		{
+			const float* p = &mesh.vertices[i];
+			radiusSquared = std::max(radiusSquared, p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+		}
+		return std::sqrt(radiusSquared);
+	}
+
+	// половины сторон коробки с центром в начале координат, в которую помещается вся сетка
+	inline Vec3 boundingHalfExtents(const MeshData& mesh)
+	{
+		Vec3 extents;
+		for (size_t i = 0; i < mesh.vertices.size(); i += MeshData::FLOATS_PER_VERTEX)
+		{
+			const float* p = &mesh.vertices[i];
+			extents = Vec3(std::max(extents.x, std::fabs(p[0])), std::max(extents.y, std::fabs(p[1])), std::max(extents.z, std::fabs(p[2])));
+		}
+		return extents;
+	}
+
+	// Доля промахов кэша преобразованных вершин на треугольник (ACMR) для кэша FIFO из cacheSize вершин:
+	// 3.0 - каждый треугольник считает вершины заново, около 0.5-0.7 - хороший порядок для сетки
+	inline float averageCacheMissRatio(const std::vector<std::uint32_t>& indices, size_t vertexCount, int cacheSize = 16)
+	{
+		if (indices.empty()) return 0.0f;
+		std::vector<std::uint32_t> cachedAt(vertexCount, 0); // номер промаха, когда вершина попала в кэш (0 - нет)
+		std::uint32_t misses = 0;
+		for (std::uint32_t index : indices)
+		{
+			if (cachedAt[index] == 0 || misses - cachedAt[index] >= static_cast<std::uint32_t>(cacheSize))
+			{
+				++misses;
+				cachedAt[index] = misses;
+			}
+		}
+		return static_cast<float>(misses) / (indices.size() / 3);
+	}
+
+	// Порядок треугольников для кэша преобразованных вершин (алгоритм Forsyth, "Linear-Speed Vertex Cache
+	// Optimisation"): у каждой вершины есть оценка - выше, если она недавно была в кэше и если у нее осталось
+	// мало непройденных треугольников; следующим берется треугольник с наибольшей суммой оценок вершин
+	inline void optimizeVertexCache(std::vector<std::uint32_t>& indices, size_t vertexCount)
+	{
+		const int CACHE_SIZE = 32;
+		size_t triangleTotal = indices.size() / 3;
+		if (triangleTotal == 0) return;
+
+		// треугольники каждой вершины: offsets[v]..offsets[v] + remaining[v] в списке adjacency
+		std::vector<std::uint32_t> offsets(vertexCount + 1, 0), remaining(vertexCount, 0);
+		for (std::uint32_t index : indices) ++offsets[index + 1];
+		for (size_t v = 0; v < vertexCount; ++v) offsets[v + 1] += offsets[v];
+		std::vector<std::uint32_t> adjacency(indices.size());
+		for (size_t t = 0; t < triangleTotal; ++t)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				std::uint32_t v = indices[t * 3 + k];
+				adjacency[offsets[v] + remaining[v]++] = static_cast<std::uint32_t>(t);
+			}
+		}
+
+		auto vertexScore = [CACHE_SIZE](int cachePosition, std::uint32_t trianglesLeft)
+		{
+			if (trianglesLeft == 0) return -1.0f;
+			float score = 0.0f;
+			if (cachePosition >= 0)
+			{
+				// три вершины последнего треугольника получают одинаковую оценку, чтобы не повторять их сразу
+				score = cachePosition < 3 ? 0.75f : std::pow(1.0f - (cachePosition - 3) / float(CACHE_SIZE - 3), 1.5f);
+			}
+			return score + 2.0f / std::sqrt(static_cast<float>(trianglesLeft));
+		};
+
+		std::vector<int> cachePosition(vertexCount, -1);
+		std::vector<float> score(vertexCount);
+		for (size_t v = 0; v < vertexCount; ++v) score[v] = vertexScore(-1, remaining[v]);
+		std::vector<float> triangleScore(triangleTotal);
+		std::vector<char> emitted(triangleTotal, 0);
+		for (size_t t = 0; t < triangleTotal; ++t)
+		{
+			triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+		}
+
+		std::vector<std::uint32_t> result;
+		result.reserve(indices.size());
+		std::vector<std::uint32_t> cache, nextCache;
+		cache.reserve(CACHE_SIZE + 3);
+		nextCache.reserve(CACHE_SIZE + 3);
+		size_t scanFrom = 0; // для поиска вне кэша: все треугольники до него уже выведены
+		std::int64_t best = 0;
+		for (size_t t = 1; t < triangleTotal; ++t)
+		{
+			if (triangleScore[t] > triangleScore[best]) best = t;
+		}
+
+		while (best >= 0)
+		{
+			emitted[best] = 1;
+			const std::uint32_t* triangle = &indices[best * 3];
+			result.insert(result.end(), triangle, triangle + 3);
+
+			// треугольник больше не учитывается у своих вершин, вершины уходят в начало кэша
+			nextCache.assign(triangle, triangle + 3);
+			for (int k = 0; k < 3; ++k)
+			{
+				std::uint32_t v = triangle[k];
+				std::uint32_t* list = &adjacency[offsets[v]];
+				std::uint32_t* end = list + remaining[v];
+				*std::find(list, end, static_cast<std::uint32_t>(best)) = *(end - 1);
+				--remaining[v];
+			}
+			for (std::uint32_t v : cache)
+			{
+				if (v != triangle[0] && v != triangle[1] && v != triangle[2]) nextCache.push_back(v);
+			}
+			for (size_t i = 0; i < nextCache.size(); ++i)
+			{
+				std::uint32_t v = nextCache[i];
+				cachePosition[v] = i < static_cast<size_t>(CACHE_SIZE) ? static_cast<int>(i) : -1;
+				score[v] = vertexScore(cachePosition[v], remaining[v]);
+			}
+			if (nextCache.size() > static_cast<size_t>(CACHE_SIZE)) nextCache.resize(CACHE_SIZE);
+			cache.swap(nextCache);
+
+			// лучший среди треугольников вершин кэша
+			best = -1;
+			float bestScore = -1.0f;
+			for (std::uint32_t v : cache)
+			{
+				for (std::uint32_t i = 0; i < remaining[v]; ++i)
+				{
+					std::uint32_t t = adjacency[offsets[v] + i];
+					const std::uint32_t* corners = &indices[t * 3];
+					triangleScore[t] = score[corners[0]] + score[corners[1]] + score[corners[2]];
+					if (triangleScore[t] > bestScore)
+					{
+						bestScore = triangleScore[t];
+						best = t;
+					}
+				}
+			}
+			// у вершин кэша треугольников не осталось - берем первый непройденный
+			if (best < 0)
+			{
+				while (scanFrom < triangleTotal && emitted[scanFrom]) ++scanFrom;
+				if (scanFrom < triangleTotal) best = static_cast<std::int64_t>(scanFrom);
+			}
+		}
+		indices.swap(result);
+	}
+
+	// вершины переставляются в порядке первого использования, чтобы их чтение из буфера шло подряд
+	inline void optimizeVertexFetch(MeshData& mesh)
+	{
+		const int stride = MeshData::FLOATS_PER_VERTEX;
+		std::vector<std::uint32_t> remap(mesh.vertexCount(), UINT32_MAX);
+		std::vector<float> vertices;
+		vertices.reserve(mesh.vertices.size());
+		std::uint32_t next = 0;
+		for (std::uint32_t& index : mesh.indices)
+		{
+			if (remap[index] == UINT32_MAX)
+			{
+				remap[index] = next++;
+				vertices.insert(vertices.end(), &mesh.vertices[index * stride], &mesh.vertices[index * stride] + stride);
+			}
+			index = remap[index];
+		}
+		mesh.vertices.swap(vertices); // вершины без треугольников отбрасываются
+	}
+
+	// обе оптимизации: порядок треугольников для кэша и порядок вершин для чтения
+	inline void optimize(MeshData& mesh)
+	{
+		optimizeVertexCache(mesh.indices, mesh.vertexCount());
+		optimizeVertexFetch(mesh);
+	}
+}
+
+// Сетка на видеокарте: VAO с позицией (атрибут 0) и нормалью (атрибут 1) и индексы.
+// Индексы 16-битные, если вершин не больше 65536, иначе 32-битные; число индексов для отрисовки берется из сетки
+class GpuMesh
+{
+public:
+	explicit GpuMesh(const MeshData& mesh)
+	{
+		glGenVertexArrays(1, &vertexArray);
+		glGenBuffers(1, &vertexBuffer);
+		glGenBuffers(1, &indexBuffer);
+
+		glBindVertexArray(vertexArray);
+		glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+		glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(float), mesh.vertices.data(), GL_STATIC_DRAW);
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+		indexCount = static_cast<GLsizei>(mesh.indices.size());
+		if (mesh.vertexCount() <= 65536)
+		{
+			std::vector<std::uint16_t> shortIndices(mesh.indices.begin(), mesh.indices.end());
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(std::uint16_t), shortIndices.data(), GL_STATIC_DRAW);
+			indexType = GL_UNSIGNED_SHORT;
+		}
+		else
+		{
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(std::uint32_t), mesh.indices.data(), GL_STATIC_DRAW);
+			indexType = GL_UNSIGNED_INT;
+		}
+
+		const GLsizei stride = MeshData::FLOATS_PER_VERTEX * sizeof(float);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)0);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(3 * sizeof(float)));
+		glEnableVertexAttribArray(1);
+
+		glBindVertexArray(0); // буфер индексов остается привязанным к VAO
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	GpuMesh(const GpuMesh&) = delete;
+	GpuMesh& operator=(const GpuMesh&) = delete;
+
+	~GpuMesh()
+	{
+		glDeleteVertexArrays(1, &vertexArray);
+		glDeleteBuffers(1, &vertexBuffer);
+		glDeleteBuffers(1, &indexBuffer);
+	}
+
+	void draw() const
+	{
+		glBindVertexArray(vertexArray);
+		glDrawElements(GL_TRIANGLES, indexCount, indexType, 0);
+		glBindVertexArray(0);
+	}
+
+	// instances копий за один вызов (атрибуты экземпляров настраиваются в VAO сетки снаружи)
+	void drawInstanced(GLsizei instances) const
+	{
+		if (instances <= 0) return;
+		glBindVertexArray(vertexArray);
+		glDrawElementsInstanced(GL_TRIANGLES, indexCount, indexType, 0, instances);
+		glBindVertexArray(0);
+	}
+
+	GLuint vao() const { return vertexArray; }
+	GLsizei count() const { return indexCount; }
+	GLenum type() const { return indexType; }
+
+private:
+	GLuint vertexArray = 0;
+	GLuint vertexBuffer = 0;
+	GLuint indexBuffer = 0;
+	GLsizei indexCount = 0;
+	GLenum indexType = GL_UNSIGNED_INT;
+};
@@ -0,0 +1,365 @@
+// программное отсечение перекрытых копий: крупнейшие копии растеризуются на процессоре в маленький буфер глубины (SSE2)
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "../common/vector_math.hpp"
+#include "instancing.hpp"
+#include "mesh.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OCCLUSION_USE_SSE2 1
+#endif
+
+// Буфер глубины низкого разрешения из плиток 8x4 пикселя, как в masked software occlusion culling:
+// вместо глубины на пиксель у плитки 32-битная маска покрытия и две глубины - опорный слой zMax0 для всей плитки
+// и рабочий слой zMax1 для пикселей из маски. Когда рабочий слой закрывает всю плитку, он становится опорным.
+// Глубина (z из NDC, больше - дальше) хранится с запасом в дальнюю сторону, пиксель считается закрытым,
+// только если заслон покрывает его целиком, поэтому видимое никогда не отсекается
+class MaskedDepthBuffer
+{
+public:
+	static const int TILE_WIDTH = 8, TILE_HEIGHT = 4;
+	static const std::uint32_t FULL_MASK = 0xFFFFFFFFu; // бит row * 8 + column
+
+	MaskedDepthBuffer(int width, int height)
+		: tilesX((std::max(width, 1) + TILE_WIDTH - 1) / TILE_WIDTH),
+		  tilesY((std::max(height, 1) + TILE_HEIGHT - 1) / TILE_HEIGHT),
+		  tiles(tilesX * tilesY)
+	{
+		clear();
+	}
+
+	int width() const { return tilesX * TILE_WIDTH; }
+	int height() const { return tilesY * TILE_HEIGHT; }
+
+	void clear()
+	{
+		for (Tile& tile : tiles) tile = { 0, 1.0f, 1.0f };
+	}
+
+	// Выпуклый многоугольник (обход против часовой стрелки, x и y в пикселях), закрывающий все под собой
+	// глубже z. Ребро E(x, y) = a * x + b * y + c >= 0 внутри; из c вычтена половина |a| + |b|,
+	// поэтому E в центре пикселя >= 0, только если внутри весь квадрат пикселя
+	void rasterize(const Vec2* polygon, int count, float z)
+	{
+		if (count < 3 || z >= 1.0f) return;
+		edgeA.resize(count);
+		edgeB.resize(count);
+		edgeC.resize(count);
+		Vec2 low = polygon[0], high = polygon[0];
+		for (int i = 0; i < count; ++i)
+		{
+			const Vec2& from = polygon[i];
+			const Vec2& to = polygon[(i + 1) % count];
+			edgeA[i] = from.y - to.y;
+			edgeB[i] = to.x - from.x;
+			edgeC[i] = -(edgeA[i] * from.x + edgeB[i] * from.y) - 0.5f * (std::fabs(edgeA[i]) + std::fabs(edgeB[i]));
+			low = Vec2(std::min(low.x, from.x), std::min(low.y, from.y));
+			high = Vec2(std::max(high.x, from.x), std::max(high.y, from.y));
+		}
+
+		// рамка обрезается по буферу еще в float: у вершин возле ближней плоскости координаты бывают огромными
+		int minX = static_cast<int>(std::max(0.0f, low.x)), maxX = static_cast<int>(std::min(width() - 1.0f, high.x));
+		int minY = static_cast<int>(std::max(0.0f, low.y)), maxY = static_cast<int>(std::min(height() - 1.0f, high.y));
+		for (int ty = minY / TILE_HEIGHT; ty <= maxY / TILE_HEIGHT; ++ty)
+		{
+			for (int tx = minX / TILE_WIDTH; tx <= maxX / TILE_WIDTH; ++tx)
+			{
+				std::uint32_t coverage = tileCoverage(count, tx * TILE_WIDTH + 0.5f, ty * TILE_HEIGHT + 0.5f);
+				if (coverage != 0) updateTile(tiles[ty * tilesX + tx], coverage, z);
+			}
+		}
+	}
+
+	// прямоугольник пикселей [x0, x1) x [y0, y1) с ближайшей глубиной z: false, если все его пиксели закрыты
+	bool isVisible(int x0, int y0, int x1, int y1, float z) const
+	{
+		x0 = std::max(x0, 0);
+		y0 = std::max(y0, 0);
+		x1 = std::min(x1, width());
+		y1 = std::min(y1, height());
+		if (x0 >= x1 || y0 >= y1) return false; // за краем экрана
+
+		for (int ty = y0 / TILE_HEIGHT; ty <= (y1 - 1) / TILE_HEIGHT; ++ty)
+		{
+			int rowBegin = std::max(y0 - ty * TILE_HEIGHT, 0), rowEnd = std::min(y1 - ty * TILE_HEIGHT, TILE_HEIGHT);
+			for (int tx = x0 / TILE_WIDTH; tx <= (x1 - 1) / TILE_WIDTH; ++tx)
+			{
+				const Tile& tile = tiles[ty * tilesX + tx];
+				// рабочий слой всегда ближе опорного (при пустой маске они совпадают): z перед ним - виден любой пиксель
+				if (z <= tile.zMax1) return true;
+				if (z > tile.zMax0) continue;
+
+				// пиксели вне маски закрыты только опорным слоем, а он дальше z
+				int columnBegin = std::max(x0 - tx * TILE_WIDTH, 0), columnEnd = std::min(x1 - tx * TILE_WIDTH, TILE_WIDTH);
+				std::uint32_t row = ((1u << (columnEnd - columnBegin)) - 1u) << columnBegin;
+				std::uint32_t rect = 0;
+				for (int r = rowBegin; r < rowEnd; ++r) rect |= row << (r * TILE_WIDTH);
+				if ((rect & ~tile.mask) != 0) return true;
+			}
+		}
+		return false;
+	}
+
+private:
+	struct Tile
+	{
+		std::uint32_t mask;
+		float zMax0; // опорный слой: не дальше этого вся плитка
+		float zMax1; // рабочий слой: не дальше этого пиксели из mask (при mask = 0 равен zMax0)
+	};
+
+	// покрытие плитки 8x4 ребрами edgeA/B/C, (x, y) - центр левого нижнего пикселя плитки
+	std::uint32_t tileCoverage(int edgeCount, float x, float y) const
+	{
+		std::uint32_t coverage = 0;
+#ifdef OCCLUSION_USE_SSE2
+		const __m128 allSet = _mm_castsi128_ps(_mm_set1_epi32(-1)), zero = _mm_setzero_ps();
+		__m128 insideLeft[TILE_HEIGHT], insideRight[TILE_HEIGHT];
+		for (int row = 0; row < TILE_HEIGHT; ++row) insideLeft[row] = insideRight[row] = allSet;
+		for (int i = 0; i < edgeCount; ++i)
+		{
+			__m128 a = _mm_set1_ps(edgeA[i]), step = _mm_set1_ps(edgeB[i]);
+			__m128 start = _mm_set1_ps(edgeA[i] * x + edgeB[i] * y + edgeC[i]);
+			__m128 left = _mm_add_ps(start, _mm_mul_ps(a, _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f)));
+			__m128 right = _mm_add_ps(start, _mm_mul_ps(a, _mm_set_ps(7.0f, 6.0f, 5.0f, 4.0f)));
+			for (int row = 0; row < TILE_HEIGHT; ++row)
+			{
+				insideLeft[row] = _mm_and_ps(insideLeft[row], _mm_cmpge_ps(left, zero));
+				insideRight[row] = _mm_and_ps(insideRight[row], _mm_cmpge_ps(right, zero));
+				left = _mm_add_ps(left, step);
+				right = _mm_add_ps(right, step);
+			}
+		}
+		for (int row = 0; row < TILE_HEIGHT; ++row)
+			coverage |= static_cast<std::uint32_t>(_mm_movemask_ps(insideLeft[row]) | (_mm_movemask_ps(insideRight[row]) << 4)) << (row * TILE_WIDTH);
+#else
+		for (int row = 0; row < TILE_HEIGHT; ++row)
+		{
+			for (int column = 0; column < TILE_WIDTH; ++column)
+			{
+				bool inside = true;
+				for (int i = 0; i < edgeCount && inside; ++i) inside = edgeA[i] * (x + column) + edgeB[i] * (y + row) + edgeC[i] >= 0.0f;
+				if (inside) coverage |= 1u << (row * TILE_WIDTH + column);
+			}
+		}
+#endif
+		return coverage;
+	}
+
+	// слияние заслона с плиткой
+	static void updateTile(Tile& tile, std::uint32_t coverage, float z)
+	{
+		if (z >= tile.zMax0) return; // не ближе того, что уже известно про всю плитку
+		// заслон намного ближе рабочего слоя, чем рабочий слой - опорного: старый рабочий слой только
+		// отодвигал бы глубину назад, поэтому он отбрасывается и слой начинается заново
+		if (tile.mask == 0 || tile.zMax1 - z > tile.zMax0 - tile.zMax1)
+		{
+			tile.mask = coverage;
+			tile.zMax1 = z;
+		}
+		else
+		{
+			tile.mask |= coverage;
+			tile.zMax1 = std::max(tile.zMax1, z);
+		}
+		if (tile.mask == FULL_MASK)
+		{
+			tile.zMax0 = tile.zMax1;
+			tile.mask = 0;
+		}
+	}
+
+	int tilesX, tilesY;
+	std::vector<Tile> tiles;
+	std::vector<float> edgeA, edgeB, edgeC; // ребра текущего многоугольника
+};
+
+// Отсечение копий, закрытых другими копиями. Каждый кадр maxOccluders самых крупных на экране копий растеризуются
+// в буфер силуэтом упрощенной сетки, затем рамка каждой копии проверяется по буферу. Упрощенная сетка должна быть
+// вписана в настоящую: выступающий край закрыл бы в буфере то, что на экране видно, и видимая копия отсеклась бы.
+// Все фигуры L4 выпуклые, поэтому силуэт - выпуклая оболочка вершин на экране, а его глубина - самая дальняя вершина.
+// Рамка и глубина копии берутся от ограничивающей коробки сетки: копия отсекается, только если закрыта вся коробка
+class OcclusionCuller
+{
+public:
+	// halfExtents - половины сторон коробки вокруг рисуемой сетки (mesh::boundingHalfExtents)
+	OcclusionCuller(const MeshData& occluderMesh, const Vec3& halfExtents, int width = 480, int height = 400)
+		: halfExtents(halfExtents), depth(width, height)
+	{
+		for (size_t i = 0; i < occluderMesh.vertices.size(); i += MeshData::FLOATS_PER_VERTEX)
+		{
+			const float* p = &occluderMesh.vertices[i];
+			occluderPoints.emplace_back(p[0], p[1], p[2]);
+		}
+		clipPoints.resize(occluderPoints.size());
+	}
+
+	// visible - копии после отсечения по пирамиде, первые litCount из них освещенные. Закрытые копии удаляются
+	// с сохранением порядка, возвращается новое число освещенных. transform = projection * view * model
+	size_t cull(std::vector<MeshInstance>& visible, size_t litCount, const Mat4& transform, size_t maxOccluders)
+	{
+		hidden = 0;
+		depth.clear();
+		rasterizeOccluders(visible, transform, maxOccluders);
+
+		size_t kept = 0, keptLit = 0;
+		for (size_t i = 0; i < visible.size(); ++i)
+		{
+			if (!isVisible(visible[i], transform)) continue;
+			if (i < litCount) ++keptLit;
+			visible[kept++] = visible[i];
+		}
+		hidden = visible.size() - kept;
+		visible.resize(kept);
+		return keptLit;
+	}
+
+	size_t hiddenCount() const { return hidden; }
+	size_t occluderCount() const { return occluders.size(); }
+
+private:
+	// Самые крупные копии (размер, деленный на расстояние до камеры), от ближних к дальним:
+	// ближние заполняют буфер первыми, и дальние уже не портят рабочий слой плиток
+	void rasterizeOccluders(const std::vector<MeshInstance>& visible, const Mat4& transform, size_t maxOccluders)
+	{
+		occluders.clear();
+		for (size_t i = 0; i < visible.size(); ++i)
+		{
+			const Vec3& p = visible[i].position;
+			float w = transform.columns[0].w * p.x + transform.columns[1].w * p.y + transform.columns[2].w * p.z + transform.columns[3].w;
+			if (w > 0.0f) occluders.emplace_back(w / visible[i].scale, i);
+		}
+		if (occluders.size() > maxOccluders)
+		{
+			std::nth_element(occluders.begin(), occluders.begin() + maxOccluders, occluders.end());
+			occluders.resize(maxOccluders);
+		}
+		std::sort(occluders.begin(), occluders.end());
+
+		for (const auto& entry : occluders)
+		{
+			// все вершины заслона разом в пространство отсечения: transform * (p * scale + position)
+			const MeshInstance& instance = visible[entry.second];
+			float s = instance.scale;
+			Mat4 instanceTransform = transform * Mat4(Vec4(s, 0, 0, 0), Vec4(0, s, 0, 0), Vec4(0, 0, s, 0), Vec4(instance.position, 1.0f));
+			transformPoints(instanceTransform, occluderPoints.data(), clipPoints.data(), occluderPoints.size());
+
+			points.clear();
+			float farthest = -1.0f;
+			bool inFront = true;
+			for (size_t v = 0; v < clipPoints.size() && inFront; ++v)
+			{
+				const Vec4& clip = clipPoints[v];
+				inFront = clip.z >= -clip.w; // перед ближней плоскостью, тогда и w > 0
+				Vec3 point = toScreen(clip.x / clip.w, clip.y / clip.w, clip.z / clip.w);
+				points.emplace_back(point.x, point.y);
+				farthest = std::max(farthest, point.z);
+			}
+			// заслон, задевающий ближнюю плоскость, пропускается: без него буфер все равно консервативен
+			if (!inFront) continue;
+			convexHull(points, hull);
+			depth.rasterize(hull.data(), static_cast<int>(hull.size()), farthest);
+		}
+	}
+
+	// выпуклая оболочка точек против часовой стрелки (монотонные цепочки Эндрю), points сортируется
+	static void convexHull(std::vector<Vec2>& points, std::vector<Vec2>& hull)
+	{
+		hull.clear();
+		if (points.size() < 3) return;
+		std::sort(points.begin(), points.end(), [](const Vec2& a, const Vec2& b) { return a.x < b.x || (a.x == b.x && a.y < b.y); });
+		auto turnsLeft = [](const Vec2& a, const Vec2& b, const Vec2& c)
+		{
+			return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x) > 0.0f;
+		};
+		hull.assign(2 * points.size(), Vec2());
+		size_t count = 0;
+		for (size_t i = 0; i < points.size(); ++i) // нижняя цепочка
+		{
+			while (count >= 2 && !turnsLeft(hull[count - 2], hull[count - 1], points[i])) --count;
+			hull[count++] = points[i];
+		}
+		for (size_t i = points.size() - 1, lower = count + 1; i-- > 0;) // верхняя
+		{
+			while (count >= lower && !turnsLeft(hull[count - 2], hull[count - 1], points[i])) --count;
+			hull[count++] = points[i];
+		}
+		hull.resize(count > 0 ? count - 1 : 0); // последняя точка совпадает с первой
+	}
+
+	// Восемь углов коробки: clip = center +- rx +- ry +- rz, где r* - столбцы матрицы, умноженные на половины сторон.
+	// Коробка, задевающая ближнюю плоскость, всегда видима
+	bool isVisible(const MeshInstance& instance, const Mat4& transform) const
+	{
+		Vec3 extents = halfExtents * instance.scale;
+		float minX, minY, minZ, maxX, maxY;
+#ifdef OCCLUSION_USE_SSE2
+		const float* m = transform.data();
+		__m128 column0 = _mm_load_ps(m), column1 = _mm_load_ps(m + 4), column2 = _mm_load_ps(m + 8), column3 = _mm_load_ps(m + 12);
+		__m128 center = _mm_add_ps(_mm_add_ps(_mm_mul_ps(column0, _mm_set1_ps(instance.position.x)), _mm_mul_ps(column1, _mm_set1_ps(instance.position.y))),
+			_mm_add_ps(_mm_mul_ps(column2, _mm_set1_ps(instance.position.z)), column3));
+		__m128 rx = _mm_mul_ps(column0, _mm_set1_ps(extents.x));
+		__m128 ry = _mm_mul_ps(column1, _mm_set1_ps(extents.y));
+		__m128 rz = _mm_mul_ps(column2, _mm_set1_ps(extents.z));
+		__m128 lowest = _mm_set1_ps(INFINITY), highest = _mm_set1_ps(-INFINITY);
+		int behindNear = 0;
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			__m128 clip = _mm_add_ps(center, (corner & 1) ? rx : _mm_sub_ps(_mm_setzero_ps(), rx));
+			clip = _mm_add_ps(clip, (corner & 2) ? ry : _mm_sub_ps(_mm_setzero_ps(), ry));
+			clip = _mm_add_ps(clip, (corner & 4) ? rz : _mm_sub_ps(_mm_setzero_ps(), rz));
+			__m128 w = _mm_shuffle_ps(clip, clip, _MM_SHUFFLE(3, 3, 3, 3));
+			// z < -w: угол за ближней плоскостью
+			behindNear |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(clip, w), _mm_setzero_ps())) & 4;
+			__m128 ndc = _mm_div_ps(clip, w);
+			lowest = _mm_min_ps(lowest, ndc);
+			highest = _mm_max_ps(highest, ndc);
+		}
+		if (behindNear != 0) return true;
+		float lowValues[4], highValues[4];
+		_mm_storeu_ps(lowValues, lowest);
+		_mm_storeu_ps(highValues, highest);
+		minX = lowValues[0], minY = lowValues[1], minZ = lowValues[2];
+		maxX = highValues[0], maxY = highValues[1];
+#else
+		Vec4 center = transform.transformPoint(instance.position);
+		Vec4 rx = transform.columns[0] * extents.x, ry = transform.columns[1] * extents.y, rz = transform.columns[2] * extents.z;
+		minX = minY = minZ = INFINITY;
+		maxX = maxY = -INFINITY;
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			Vec4 clip = center + ((corner & 1) ? rx : -rx) + ((corner & 2) ? ry : -ry) + ((corner & 4) ? rz : -rz);
+			if (clip.z < -clip.w) return true;
+			minX = std::min(minX, clip.x / clip.w), maxX = std::max(maxX, clip.x / clip.w);
+			minY = std::min(minY, clip.y / clip.w), maxY = std::max(maxY, clip.y / clip.w);
+			minZ = std::min(minZ, clip.z / clip.w);
+		}
+#endif
+		// все пиксели, которые задевает рамка (за краем экрана рамка обрезается до соседнего с ним пикселя)
+		Vec3 low = toScreen(std::max(minX, -1.0f), std::max(minY, -1.0f), minZ);
+		Vec3 high = toScreen(std::min(maxX, 1.0f), std::min(maxY, 1.0f), minZ);
+		return depth.isVisible(static_cast<int>(std::floor(low.x)), static_cast<int>(std::floor(low.y)),
+			static_cast<int>(std::floor(high.x)) + 1, static_cast<int>(std::floor(high.y)) + 1, minZ);
+	}
+
+	Vec3 toScreen(float x, float y, float z) const
+	{
+		return Vec3((x * 0.5f + 0.5f) * depth.width(), (y * 0.5f + 0.5f) * depth.height(), z);
+	}
+
+	std::vector<Vec3> occluderPoints; // вершины упрощенной сетки
+	std::vector<Vec4> clipPoints;     // они же у текущего заслона в пространстве отсечения
+	Vec3 halfExtents;
+	MaskedDepthBuffer depth;
+	std::vector<std::pair<float, size_t>> occluders; // (расстояние / размер, номер копии)
+	std::vector<Vec2> points, hull; // вершины текущего заслона на экране и их оболочка
+	size_t hidden = 0;
+};
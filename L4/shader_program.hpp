@@ -0,0 +1,214 @@
+// шейдерная программа: проверка сборки, блоки uniform и кэш собранной программы на диске
+
+#pragma once
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../common/vector_math.hpp"
+
+// Программа из вершинного и фрагментного шейдеров. Все uniform лежат в блоках (bindBlock), их буферы
+// заполняет вызывающий код. Собранная программа сохраняется в файл (glGetProgramBinary),
+// и при следующем запуске на том же драйвере компиляция пропускается.
+class ShaderProgram
+{
+public:
+	ShaderProgram() = default;
+	ShaderProgram(const ShaderProgram&) = delete;
+	ShaderProgram& operator=(const ShaderProgram&) = delete;
+
+	~ShaderProgram()
+	{
+		if (program != 0) glDeleteProgram(program);
+	}
+
+	// false, если шейдеры не собрались (журнал сборки печатается в std::cerr)
+	bool build(const char* vertexSource, const char* fragmentSource, const std::string& cacheFile = "")
+	{
+		bool binarySupported = GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary;
+		std::uint64_t key = cacheKey(vertexSource, fragmentSource);
+		if (binarySupported && !cacheFile.empty() && loadBinary(cacheFile, key))
+		{
+			fromCache = true;
+			return true;
+		}
+
+		GLuint vertexShader = compile(GL_VERTEX_SHADER, vertexSource);
+		GLuint fragmentShader = compile(GL_FRAGMENT_SHADER, fragmentSource);
+		if (vertexShader == 0 || fragmentShader == 0)
+		{
+			glDeleteShader(vertexShader);
+			glDeleteShader(fragmentShader);
+			return false;
+		}
+
+		program = glCreateProgram();
+		glAttachShader(program, vertexShader);
+		glAttachShader(program, fragmentShader);
+		if (binarySupported) glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		glLinkProgram(program);
+		glDetachShader(program, vertexShader);
+		glDetachShader(program, fragmentShader);
+		glDeleteShader(vertexShader); // после сборки программы шейдеры больше не нужны
+		glDeleteShader(fragmentShader);
+
+		if (!checkStatus(program, GL_LINK_STATUS, "link"))
+		{
+			glDeleteProgram(program);
+			program = 0;
+			return false;
+		}
+		if (binarySupported && !cacheFile.empty()) saveBinary(cacheFile, key);
+		return true;
+	}
+
+	GLuint id() const { return program; }
+	bool loadedFromCache() const { return fromCache; }
+
+	void use() const
+	{
+		glUseProgram(program);
+	}
+
+	// привязать блок uniform к точке привязки буфера
+	void bindBlock(const char* blockName, GLuint binding)
+	{
+		GLuint index = glGetUniformBlockIndex(program, blockName);
+		if (index != GL_INVALID_INDEX) glUniformBlockBinding(program, index, binding);
+	}
+
+private:
+	struct CacheHeader
+	{
+		char magic[4];        // "L4SB"
+		std::uint64_t key;    // исходники шейдеров и версия драйвера
+		GLenum format;        // формат двоичной программы у драйвера
+		std::uint32_t length;
+	};
+
+	static GLuint compile(GLenum type, const char* source)
+	{
+		GLuint shader = glCreateShader(type);
+		glShaderSource(shader, 1, &source, nullptr);
+		glCompileShader(shader);
+		if (!checkStatus(shader, GL_COMPILE_STATUS, type == GL_VERTEX_SHADER ? "vertex shader" : "fragment shader"))
+		{
+			glDeleteShader(shader);
+			return 0;
+		}
+		return shader;
+	}
+
+	static bool checkStatus(GLuint object, GLenum status, const char* stage)
+	{
+		bool isProgram = status == GL_LINK_STATUS;
+		GLint success = GL_FALSE;
+		if (isProgram) glGetProgramiv(object, status, &success);
+		else glGetShaderiv(object, status, &success);
+		if (success == GL_TRUE) return true;
+
+		GLint logLength = 0;
+		if (isProgram) glGetProgramiv(object, GL_INFO_LOG_LENGTH, &logLength);
+		else glGetShaderiv(object, GL_INFO_LOG_LENGTH, &logLength);
+		std::vector<char> log(logLength > 1 ? logLength : 1, '\0');
+		if (isProgram) glGetProgramInfoLog(object, static_cast<GLsizei>(log.size()), nullptr, log.data());
+		else glGetShaderInfoLog(object, static_cast<GLsizei>(log.size()), nullptr, log.data());
+		std::cerr << "Shader " << stage << " failed:\n" << log.data() << std::endl;
+		return false;
+	}
+
+	// FNV-1a от исходников и строк драйвера: другой драйвер или измененный шейдер - другой ключ
+	static std::uint64_t cacheKey(const char* vertexSource, const char* fragmentSource)
+	{
+		std::uint64_t hash = 14695981039346656037ull;
+		auto add = [&hash](const char* text)
+		{
+			for (; text != nullptr && *text != '\0'; ++text)
+			{
+				hash ^= static_cast<unsigned char>(*text);
+				hash *= 1099511628211ull;
+			}
+			hash ^= 0xFF; // разделитель, чтобы "ab" + "c" и "a" + "bc" различались
+			hash *= 1099511628211ull;
+		};
+		add(vertexSource);
+		add(fragmentSource);
+		add(reinterpret_cast<const char*>(glGetString(GL_VENDOR)));
+		add(reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+		add(reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+		return hash;
+	}
+
+	bool loadBinary(const std::string& fileName, std::uint64_t key)
+	{
+		std::ifstream file(fileName, std::ios::binary);
+		CacheHeader header;
+		if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+		if (std::memcmp(header.magic, "L4SB", 4) != 0 || header.key != key) return false;
+		std::vector<char> binary(header.length);
+		if (!file.read(binary.data(), binary.size())) return false;
+
+		program = glCreateProgram();
+		glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+		GLint success = GL_FALSE;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (success != GL_TRUE) // драйвер может отвергнуть старый формат - тогда просто собираем заново
+		{
+			glDeleteProgram(program);
+			program = 0;
+			return false;
+		}
+		return true;
+	}
+
+	void saveBinary(const std::string& fileName, std::uint64_t key) const
+	{
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0) return;
+		std::vector<char> binary(length);
+		CacheHeader header = { { 'L', '4', 'S', 'B' }, key, 0, 0 };
+		glGetProgramBinary(program, length, nullptr, &header.format, binary.data());
+		header.length = static_cast<std::uint32_t>(length);
+
+		std::ofstream file(fileName, std::ios::binary);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(binary.data(), binary.size());
+		if (!file) std::cerr << "Cannot write " << fileName << std::endl;
+	}
+
+	GLuint program = 0;
+	bool fromCache = false;
+};
+
+// Камера и положение фигуры: блок Camera в шейдере (std140: матрицы по 64 байта, vec3 выравнивается на 16)
+struct CameraBlock
+{
+	Mat4 model;
+	Mat4 view;
+	Mat4 projection;
+	Vec3 viewPos;
+	float padding;
+};
+
+// Прожектор: блок Light в шейдере. Каждый float после vec3 занимает его четвертую компоненту, как в std140
+struct LightBlock
+{
+	Vec3 lightPos;
+	float cutoff;       // косинус внутреннего угла конуса
+	Vec3 lightDir;
+	float outerCutoff;  // косинус внешнего угла
+	Vec3 lightColor;
+	float constant;     // коэффициенты затухания
+	float linear;
+	float quadratic;
+	float padding[2];
+};
+
+static_assert(sizeof(CameraBlock) == 208, "CameraBlock must match std140 layout");
+static_assert(sizeof(LightBlock) == 64, "LightBlock must match std140 layout");
@@ -0,0 +1,143 @@
+// прожектор L4 на процессоре: та же модель, что во фрагментном шейдере, SSE2 по четыре фрагмента и несколько потоков
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "../common/vector_math.hpp"
+#include "../common/worker_pool.hpp"
+#include "shader_program.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SHADING_USE_SSE2 1
+#endif
+
+// Фрагменты по компонентам (x отдельно от y и z): четыре соседних значения загружаются одной командой.
+// Положения и нормали в мировых координатах - как fragPos и fragNormal на входе фрагментного шейдера
+struct FragmentBuffer
+{
+	std::vector<float> x, y, z;
+	std::vector<float> normalX, normalY, normalZ;
+
+	size_t size() const { return x.size(); }
+
+	void resize(size_t count)
+	{
+		for (std::vector<float>* component : { &x, &y, &z, &normalX, &normalY, &normalZ }) component->resize(count);
+	}
+};
+
+// цвета фрагментов, тоже по компонентам
+struct ColorBuffer
+{
+	std::vector<float> r, g, b;
+
+	size_t size() const { return r.size(); }
+
+	void resize(size_t count)
+	{
+		r.resize(count);
+		g.resize(count);
+		b.resize(count);
+	}
+};
+
+// Один фрагмент строка в строку по фрагментному шейдеру (эталон для векторного варианта и для проверки шейдера).
+// Как и в шейдере, epsilon = outerCutoff - cutoff отрицательный: свет есть только вне внешнего конуса
+inline Vec3 shadeSpotlight(const LightBlock& light, const Vec3& fragPos, const Vec3& fragNormal)
+{
+	Vec3 lightDirToFrag = normalize(light.lightPos - fragPos);
+	float theta = dot(lightDirToFrag, normalize(light.lightDir));
+	float epsilon = light.outerCutoff - light.cutoff;
+	float intensity = std::min(std::max((theta - light.outerCutoff) / epsilon, 0.0f), 1.0f);
+
+	float distance = length(light.lightPos - fragPos);
+	float attenuation = 1.0f / (light.constant + light.linear * distance + light.quadratic * distance * distance);
+
+	Vec3 ambient = 0.1f * light.lightColor;
+	Vec3 diffuse = std::max(dot(lightDirToFrag, normalize(fragNormal)), 0.0f) * light.lightColor;
+	return (ambient + diffuse) * attenuation * intensity;
+}
+
+// Освещение буфера фрагментов. Все, что не зависит от фрагмента (нормированное направление прожектора,
+// epsilon, фоновый свет), считается один раз. Деление и корень точные (без _mm_rcp_ps/_mm_rsqrt_ps),
+// поэтому результат отличается от shadeSpotlight только округлением. Большие буферы делятся между потоками общего пула
+class SpotlightShader
+{
+public:
+	explicit SpotlightShader(const LightBlock& light)
+		: light(light), direction(normalize(light.lightDir)), epsilon(light.outerCutoff - light.cutoff)
+	{
+	}
+
+	// colors получает размер fragments; threads - сколько потоков общего пула занять (0 - все)
+	void shade(const FragmentBuffer& fragments, ColorBuffer& colors, unsigned threads = 0) const
+	{
+		colors.resize(fragments.size());
+		WorkerPool::shared().parallelFor(fragments.size(), PARALLEL_CHUNK,
+			[&](size_t begin, size_t end) { shadeRange(fragments, colors, begin, end); }, threads);
+	}
+
+	// фрагменты [begin, end) в текущем потоке
+	void shadeRange(const FragmentBuffer& fragments, ColorBuffer& colors, size_t begin, size_t end) const
+	{
+		size_t i = begin;
+#ifdef SHADING_USE_SSE2
+		const __m128 lightX = _mm_set1_ps(light.lightPos.x), lightY = _mm_set1_ps(light.lightPos.y), lightZ = _mm_set1_ps(light.lightPos.z);
+		const __m128 directionX = _mm_set1_ps(direction.x), directionY = _mm_set1_ps(direction.y), directionZ = _mm_set1_ps(direction.z);
+		const __m128 outerCutoff = _mm_set1_ps(light.outerCutoff), spotEpsilon = _mm_set1_ps(epsilon);
+		const __m128 constant = _mm_set1_ps(light.constant), linear = _mm_set1_ps(light.linear), quadratic = _mm_set1_ps(light.quadratic);
+		const __m128 colorR = _mm_set1_ps(light.lightColor.x), colorG = _mm_set1_ps(light.lightColor.y), colorB = _mm_set1_ps(light.lightColor.z);
+		const __m128 ambientScale = _mm_set1_ps(0.1f), zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+		for (; i + 4 <= end; i += 4)
+		{
+			// lightPos - fragPos, его длина и направление
+			__m128 toLightX = _mm_sub_ps(lightX, _mm_loadu_ps(&fragments.x[i]));
+			__m128 toLightY = _mm_sub_ps(lightY, _mm_loadu_ps(&fragments.y[i]));
+			__m128 toLightZ = _mm_sub_ps(lightZ, _mm_loadu_ps(&fragments.z[i]));
+			__m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(toLightX, toLightX), _mm_mul_ps(toLightY, toLightY)), _mm_mul_ps(toLightZ, toLightZ)));
+			toLightX = _mm_div_ps(toLightX, distance);
+			toLightY = _mm_div_ps(toLightY, distance);
+			toLightZ = _mm_div_ps(toLightZ, distance);
+
+			// конус прожектора
+			__m128 theta = _mm_add_ps(_mm_add_ps(_mm_mul_ps(toLightX, directionX), _mm_mul_ps(toLightY, directionY)), _mm_mul_ps(toLightZ, directionZ));
+			__m128 intensity = _mm_min_ps(_mm_max_ps(_mm_div_ps(_mm_sub_ps(theta, outerCutoff), spotEpsilon), zero), one);
+
+			// затухание
+			__m128 attenuation = _mm_div_ps(one, _mm_add_ps(_mm_add_ps(constant, _mm_mul_ps(linear, distance)), _mm_mul_ps(_mm_mul_ps(quadratic, distance), distance)));
+
+			// рассеянный свет по нормированной нормали
+			__m128 normalX = _mm_loadu_ps(&fragments.normalX[i]), normalY = _mm_loadu_ps(&fragments.normalY[i]), normalZ = _mm_loadu_ps(&fragments.normalZ[i]);
+			__m128 normalLength = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(normalX, normalX), _mm_mul_ps(normalY, normalY)), _mm_mul_ps(normalZ, normalZ)));
+			__m128 diffuse = _mm_add_ps(_mm_add_ps(_mm_mul_ps(toLightX, _mm_div_ps(normalX, normalLength)), _mm_mul_ps(toLightY, _mm_div_ps(normalY, normalLength))),
+				_mm_mul_ps(toLightZ, _mm_div_ps(normalZ, normalLength)));
+			diffuse = _mm_max_ps(diffuse, zero);
+
+			// (ambient + diffuse) * attenuation * intensity, где ambient = 0.1 * lightColor и diffuse = factor * lightColor
+			__m128 scale = _mm_mul_ps(attenuation, intensity);
+			_mm_storeu_ps(&colors.r[i], _mm_mul_ps(_mm_add_ps(_mm_mul_ps(ambientScale, colorR), _mm_mul_ps(diffuse, colorR)), scale));
+			_mm_storeu_ps(&colors.g[i], _mm_mul_ps(_mm_add_ps(_mm_mul_ps(ambientScale, colorG), _mm_mul_ps(diffuse, colorG)), scale));
+			_mm_storeu_ps(&colors.b[i], _mm_mul_ps(_mm_add_ps(_mm_mul_ps(ambientScale, colorB), _mm_mul_ps(diffuse, colorB)), scale));
+		}
+#endif
+		for (; i < end; ++i)
+		{
+			Vec3 color = shadeSpotlight(light, Vec3(fragments.x[i], fragments.y[i], fragments.z[i]),
+				Vec3(fragments.normalX[i], fragments.normalY[i], fragments.normalZ[i]));
+			colors.r[i] = color.x;
+			colors.g[i] = color.y;
+			colors.b[i] = color.z;
+		}
+	}
+
+private:
+	static constexpr size_t PARALLEL_CHUNK = 1 << 14; // меньше этого на поток делить работу невыгодно
+
+	LightBlock light;
+	Vec3 direction;
+	float epsilon;
+};
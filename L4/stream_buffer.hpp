@@ -0,0 +1,167 @@
+// кольцевой буфер для данных кадра: постоянно отображенная память, по области на кадр и забор (fence) на каждую область
+
+#pragma once
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Буфер из REGIONS областей, кадр пишет в свою область, пока видеокарта читает две предыдущие.
+// С GL 4.4 / ARB_buffer_storage память отображается один раз (GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT):
+// данные кадра записываются прямо в буфер, без копии в драйвере и без неявного ожидания видеокарты.
+// Без них данные собираются в памяти процесса и отправляются одним glBufferSubData на кадр в свободную область.
+// Перед записью в область ждем ее забор - видеокарта закончила кадр, который читал эту область три кадра назад.
+class StreamBuffer
+{
+public:
+	static const int REGIONS = 3;
+
+	// Часть области текущего кадра: куда писать и смещение от начала буфера (для glBindBufferRange и атрибутов)
+	struct Allocation
+	{
+		void* data;
+		GLintptr offset;
+	};
+
+	explicit StreamBuffer(size_t regionBytes)
+		: persistent(GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage)
+	{
+		GLint uniformAlignment = 256;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+		alignment = std::max<size_t>(uniformAlignment, 16);
+		create(regionBytes);
+	}
+
+	StreamBuffer(const StreamBuffer&) = delete;
+	StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+	~StreamBuffer()
+	{
+		destroy();
+	}
+
+	GLuint id() const { return buffer; }
+	bool isPersistent() const { return persistent; }
+	size_t capacity() const { return regionSize; }
+	size_t usedBytes() const { return used; }
+	std::uint64_t waitCount() const { return waits; } // сколько раз процессор ждал видеокарту
+
+	// Области меньше regionBytes пересоздаются с запасом (дожидаясь видеокарты). Только между кадрами:
+	// смещения, выданные раньше в этом кадре, указывали бы в старый буфер
+	void reserve(size_t regionBytes)
+	{
+		if (regionBytes <= regionSize) return;
+		for (GLsync& fence : fences) waitFor(fence);
+		destroy();
+		create(std::max(regionBytes, regionSize * 2));
+	}
+
+	// начало кадра: следующая область, когда видеокарта ее отпустит
+	void beginFrame()
+	{
+		region = (region + 1) % REGIONS;
+		if (fences[region] != nullptr && glClientWaitSync(fences[region], 0, 0) != GL_ALREADY_SIGNALED) ++waits;
+		waitFor(fences[region]);
+		used = 0;
+	}
+
+	// место под bytes байт в области кадра (смещение кратно выравниванию блоков uniform);
+	// data = nullptr, если область кончилась - reserve нужно было вызвать до кадра
+	Allocation allocate(size_t bytes)
+	{
+		size_t start = (used + alignment - 1) / alignment * alignment;
+		if (start + bytes > regionSize) return { nullptr, 0 };
+		used = start + bytes;
+		size_t offset = region * regionSize + start;
+		return { persistent ? mapped + offset : staging.data() + start, static_cast<GLintptr>(offset) };
+	}
+
+	// блок uniform с раскладкой std140 в область кадра и на точку привязки binding
+	template <typename Block>
+	bool writeUniform(GLuint binding, const Block& block)
+	{
+		Allocation allocation = allocate(sizeof(Block));
+		if (allocation.data == nullptr) return false;
+		std::memcpy(allocation.data, &block, sizeof(Block));
+		glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, allocation.offset, sizeof(Block));
+		return true;
+	}
+
+	// записанное в кадре становится видно видеокарте (до первого вызова отрисовки, который его читает)
+	void flush()
+	{
+		if (persistent || used == 0) return;
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glBufferSubData(GL_ARRAY_BUFFER, region * regionSize, used, staging.data());
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	// конец кадра: забор после всех команд, читающих область
+	void endFrame()
+	{
+		fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+private:
+	static void waitFor(GLsync& fence)
+	{
+		if (fence == nullptr) return;
+		// первое ожидание отправляет накопленные команды, иначе забор может не сработать никогда
+		GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		while (result == GL_TIMEOUT_EXPIRED) result = glClientWaitSync(fence, 0, 1000000000);
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+
+	void create(size_t regionBytes)
+	{
+		regionSize = (regionBytes + alignment - 1) / alignment * alignment;
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		GLsizeiptr size = static_cast<GLsizeiptr>(regionSize * REGIONS);
+		if (persistent)
+		{
+			const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+			mapped = static_cast<char*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags));
+		}
+		else
+		{
+			glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+			staging.resize(regionSize);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	void destroy()
+	{
+		for (GLsync& fence : fences)
+		{
+			if (fence != nullptr) glDeleteSync(fence);
+			fence = nullptr;
+		}
+		if (mapped != nullptr)
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, buffer);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			mapped = nullptr;
+		}
+		glDeleteBuffers(1, &buffer);
+		buffer = 0;
+	}
+
+	bool persistent;
+	size_t alignment = 256;
+	GLuint buffer = 0;
+	size_t regionSize = 0;
+	int region = REGIONS - 1; // первый beginFrame начнет с области 0
+	size_t used = 0;
+	char* mapped = nullptr;       // весь буфер, если он отображен постоянно
+	std::vector<char> staging;    // данные кадра, если нет
+	GLsync fences[REGIONS] = {};
+	std::uint64_t waits = 0;
+};
@@ -5,42 +5,19 @@
 #include <vector>
 #include <iostream>
 #include <limits>
+#include <random>
+#include <string>
+
+#include "../common/microbench.hpp"
+#include "../common/profiler.hpp"
+#include "../common/vector_math.hpp"
 
 #define M_PI 3.14159265358979323846
 
 int traceDepth = 5; // глубина трассировки лучей, максимальное количество отражений и преломлений для одного луча
 
-// вектор для 3D операций
-struct Vector3 
-{
-	float x, y, z; // координаты
-
-	Vector3() : x(0), y(0), z(0) {} // конструкторы
-	Vector3(float x, float y, float z) : x(x), y(y), z(z) {}
-	// перегрузка операторов
-	Vector3 operator+(const Vector3& v) const { return Vector3(x + v.x, y + v.y, z + v.z); }
-	Vector3 operator-(const Vector3& v) const { return Vector3(x - v.x, y - v.y, z - v.z); }
-	Vector3 operator*(float s) const { return Vector3(x * s, y * s, z * s); }
-	Vector3 operator*(const Vector3& v) const { return Vector3(x * v.x, y * v.y, z * v.z); } // Покомпонентное умножение
-	Vector3 operator/(float s) const { return Vector3(x / s, y / s, z / s); }
-	// скалярное произведенеие
-	float dot(const Vector3& v) const { return x * v.x + y * v.y + z * v.z; }
-	// нормализует вектор
-	Vector3 normalize() const 
-	{
-		float len = std::sqrt(x * x + y * y + z * z);
-		return *this / len;
-	}
-	// векторное произведение
-	Vector3 cross(const Vector3& v) const 
-	{
-		return Vector3(
-			y * v.z - z * v.y,
-			z * v.x - x * v.z,
-			x * v.y - y * v.x
-		);
-	}
-};
+// вектор для 3D операций (общий для лабораторных, см. common/vector_math.hpp)
+using Vector3 = Vec3;
 
 
 // сфера
@@ -164,13 +141,29 @@ struct Camera
 	}
 	// считаем направление луча из камеры для пикселя на изображении
 	Vector3 getRayDirection(float x, float y, float imageWidth, float imageHeight) const 
+	{
+		return rayTarget(x, y, imageWidth, imageHeight).normalize(); // вектор направления
+	}
+	// направления лучей для всей строки пикселей: нормируются одним пакетом, результат тот же, что у getRayDirection
+	void getRowDirections(float y, size_t imageWidth, float imageHeight, Vector3* directions) const 
+	{
+		for (size_t x = 0; x < imageWidth; ++x) 
+		{
+			directions[x] = rayTarget(static_cast<float>(x), y, static_cast<float>(imageWidth), imageHeight);
+		}
+		normalizeBatch(directions, imageWidth);
+	}
+
+private:
+	// точка на плоскости изображения на расстоянии 1 от камеры
+	Vector3 rayTarget(float x, float y, float imageWidth, float imageHeight) const 
 	{
 		float fovScale = tan(M_PI / 4); // масштаб поля зрения
 		float aspectRatio = imageWidth / imageHeight; // соотношение сторон
 		// преобразуем пиксельные координаты в пространственные
 		float px = (2 * (x + 0.5) / imageWidth - 1) * aspectRatio * fovScale;
 		float py = (1 - 2 * (y + 0.5) / imageHeight) * fovScale;
-		return (forward + right * px + up * py).normalize(); // вектор направления
+		return forward + right * px + up * py;
 	}
 };
 
@@ -282,9 +275,83 @@ Vector3 traceRay(const Vector3& origin, const Vector3& direction,
 	return color;
 }
 
+// Замеры пересечений и лучей по отдельности на случайных входах (зерно фиксированное): 1024 луча из области
+// перед сценой в сторону сцены и 1024 объекта того же размера, что в сцене, часть лучей попадает, часть нет
+int runKernelBenchmark(const std::string& filter) 
+{
+	const size_t INPUTS = 1024; // степень двойки: номер входа - i & (INPUTS - 1)
+	std::mt19937 generator(12345);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	auto randomVector = [&](float scale, const Vector3& center) { return center + Vector3(unit(generator), unit(generator), unit(generator)) * scale; };
+
+	std::vector<Vector3> origins, directions, normals;
+	std::vector<Sphere> spheres;
+	std::vector<Plane> planes;
+	std::vector<Cube> cubes;
+	std::vector<float> etas, pixelX, pixelY;
+	for (size_t i = 0; i < INPUTS; ++i) 
+	{
+		origins.push_back(randomVector(2.0f, Vector3(0, 1, -1)));
+		directions.push_back((randomVector(3.0f, Vector3(0, 0, 5)) - origins.back()).normalize());
+		normals.push_back(randomVector(1.0f, Vector3(0, 0, -1)).normalize());
+		spheres.push_back(Sphere(randomVector(3.0f, Vector3(0, 0, 5)), 0.5f + std::abs(unit(generator)), Vector3(1, 0, 0), 0.5, 0.5, 1.5));
+		planes.push_back(Plane(randomVector(2.0f, Vector3(0, -2, 0)), randomVector(1.0f, Vector3(0, 1, 0)), Vector3(1, 1, 1), 0.3));
+		Vector3 corner = randomVector(3.0f, Vector3(0, 0, 5));
+		cubes.push_back(Cube(corner, corner + Vector3(1, 1, 1), Vector3(0, 0, 1), 0.4, 0.6, 1.33));
+		etas.push_back(unit(generator) < 0 ? 1 / 1.5f : 1.5f);
+		pixelX.push_back((unit(generator) + 1) * 600);
+		pixelY.push_back((unit(generator) + 1) * 500);
+	}
+	Camera camera(Vector3(0, 2, -0.5), Vector3(-1, 0, 3), Vector3(0, 1, 0));
+	std::vector<Vector3> row(1200);
+
+	MicroBenchmark bench(filter);
+	bench.run("Sphere::intersect", [&](size_t i) 
+	{
+		float t = 0;
+		keepResult(spheres[i & (INPUTS - 1)].intersect(origins[i * 7 & (INPUTS - 1)], directions[i * 7 & (INPUTS - 1)], t));
+		keepResult(t);
+	});
+	bench.run("Plane::intersect", [&](size_t i) 
+	{
+		float t = 0;
+		keepResult(planes[i & (INPUTS - 1)].intersect(origins[i * 7 & (INPUTS - 1)], directions[i * 7 & (INPUTS - 1)], t));
+		keepResult(t);
+	});
+	bench.run("Cube::intersect", [&](size_t i) 
+	{
+		float t = 0;
+		keepResult(cubes[i & (INPUTS - 1)].intersect(origins[i * 7 & (INPUTS - 1)], directions[i * 7 & (INPUTS - 1)], t));
+		keepResult(t);
+	});
+	bench.run("refract", [&](size_t i) 
+	{
+		keepResult(refract(directions[i & (INPUTS - 1)], normals[i * 7 & (INPUTS - 1)], etas[i & (INPUTS - 1)]));
+	});
+	bench.run("Camera::getRayDirection", [&](size_t i) 
+	{
+		keepResult(camera.getRayDirection(pixelX[i & (INPUTS - 1)], pixelY[i & (INPUTS - 1)], 1200, 1000));
+	});
+	bench.run("Camera::getRowDirections (1200 rays)", [&](size_t i) 
+	{
+		camera.getRowDirections(static_cast<float>(i % 1000), 1200, 1000, row.data());
+		keepResult(row[i % 1200]);
+	}, 1200);
+	return 0;
+}
+
 // основной рендеринг
-int main() 
+// Параметры запуска:
+//   --kernel-bench [фильтр] - замеры пересечений и лучей по отдельности (только с фильтром в имени) без окна
+//   --profile [файл.csv]    - замер времени трассировки и этапов кадра
+int main(int argc, char* argv[]) 
 {
+	FrameProfiler::instance().configure(argc, argv);
+	if (argc > 1 && std::string(argv[1]) == "--kernel-bench") 
+	{
+		return runKernelBenchmark(argc > 2 ? argv[2] : "");
+	}
+
 	sf::RenderWindow window(sf::VideoMode(1200, 1000), "Traicing luchey");
 	sf::Image image; // храним пиксели отрендеренного изображения
 	image.create(1200, 1000);
@@ -314,12 +381,14 @@ int main()
 
 	Camera camera(Vector3(0, 2, -0.5), Vector3(-1, 0, 3), Vector3(0, 1, 0));
 
+	PROFILE_BEGIN(traceTimer, "trace");
+	std::vector<Vector3> directions(1200); // направления лучей из камеры для строки
 	for (int y = 0; y < 1000; ++y) 
 	{
+		camera.getRowDirections(y, 1200, 1000, directions.data());
 		for (int x = 0; x < 1200; ++x) 
 		{
-			Vector3 direction = camera.getRayDirection(x, y, 1200, 1000); // направление луча из камеры
-			Vector3 color = traceRay(camera.position, direction, spheres, planes, cubes, lights, traceDepth);
+			Vector3 color = traceRay(camera.position, directions[x], spheres, planes, cubes, lights, traceDepth);
 			sf::Color pixelColor(
 				std::min(255, static_cast<int>(color.x * 255)),
 				std::min(255, static_cast<int>(color.y * 255)),
@@ -329,12 +398,19 @@ int main()
 		}
 	}
 
+	traceTimer.stop();
+
+	PROFILE_BEGIN(uploadTimer, "upload");
 	sf::Texture texture; // создаем текстуру из картинки
 	texture.loadFromImage(image);
 	sf::Sprite sprite(texture); // для вывода на экран
+	uploadTimer.stop();
+	FrameProfiler::instance().endFrame(); // трассировка - отдельный кадр, ее сводка печатается сразу
+	if (FrameProfiler::instance().isEnabled()) FrameProfiler::instance().report(std::cout);
 
 	while (window.isOpen()) 
 	{
+		PROFILE_BEGIN(inputTimer, "input");
 		sf::Event event;
 		while (window.pollEvent(event)) 
 		{
@@ -343,10 +419,19 @@ int main()
 				window.close();
 			}
 		}
+		inputTimer.stop();
+
+		PROFILE_BEGIN(drawTimer, "draw");
 		window.clear();
 		window.draw(sprite); // рисуем спрайт
+		drawTimer.stop();
+
+		PROFILE_BEGIN(displayTimer, "display");
 		window.display();
+		displayTimer.stop();
+		FrameProfiler::instance().endFrame();
 	}
+	FrameProfiler::instance().finish();
 
 	return 0;
 }
@@ -0,0 +1,279 @@
+// асинхронный вывод сообщений: поток отрисовки только кладет запись в очередь, печатает фоновый поток
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// Одно сообщение: указатель на строку-шаблон (строковый литерал, копировать не нужно) и до четырех чисел.
+// В шаблоне каждое {} заменяется очередным числом: "Cylinder moved up: {}"
+struct LogRecord
+{
+	static constexpr int MAX_ARGS = 4;
+
+	struct Argument
+	{
+		bool isInteger;
+		union
+		{
+			long long integer;
+			double real;
+		};
+	};
+
+	const char* format;
+	int argumentCount;
+	Argument arguments[MAX_ARGS];
+};
+
+// Ограниченная очередь без блокировок на несколько писателей и одного читателя.
+// У каждой ячейки свой счетчик: писатель занимает позицию через compare_exchange и публикует запись,
+// сдвигая счетчик ячейки, читатель освобождает ячейку для следующего круга тем же способом.
+class LogQueue
+{
+public:
+	static constexpr std::uint32_t CAPACITY = 1024; // степень двойки
+
+	LogQueue()
+		: cells(CAPACITY)
+	{
+		for (std::uint32_t i = 0; i < CAPACITY; ++i) cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	// false, если очередь заполнена (запись не ждет, сообщение просто теряется)
+	bool push(const LogRecord& record)
+	{
+		std::uint32_t position = tail.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			Cell& cell = cells[position & (CAPACITY - 1)];
+			std::int32_t difference = static_cast<std::int32_t>(cell.sequence.load(std::memory_order_acquire) - position);
+			if (difference == 0)
+			{
+				if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					cell.record = record;
+					cell.sequence.store(position + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (difference < 0)
+			{
+				return false;
+			}
+			else
+			{
+				position = tail.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	bool pop(LogRecord& record)
+	{
+		Cell& cell = cells[head & (CAPACITY - 1)];
+		if (cell.sequence.load(std::memory_order_acquire) != head + 1) return false;
+		record = cell.record;
+		cell.sequence.store(head + CAPACITY, std::memory_order_release);
+		++head;
+		return true;
+	}
+
+private:
+	struct Cell
+	{
+		std::atomic<std::uint32_t> sequence{ 0 };
+		LogRecord record;
+	};
+
+	std::vector<Cell> cells;
+	std::atomic<std::uint32_t> tail{ 0 }; // следующая позиция для записи (общая для писателей)
+	std::uint32_t head = 0;               // следующая позиция для чтения (только фоновый поток)
+};
+
+// Фоновый вывод. write() стоит одну запись в очередь: без форматирования, выделения памяти и сброса потока.
+// Фоновый поток раз в несколько миллисекунд забирает записи, форматирует их и сбрасывает вывод один раз на пачку.
+// Одинаковые сообщения (тот же шаблон) чаще rateLimit не печатаются: промежуточные схлопываются,
+// а печатается последнее значение с числом пропущенных, так что итоговое состояние всегда видно.
+class AsyncLog
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	static AsyncLog& instance()
+	{
+		static AsyncLog log;
+		return log;
+	}
+
+	template <typename... Args>
+	void write(const char* format, Args... values)
+	{
+		static_assert(sizeof...(Args) <= LogRecord::MAX_ARGS, "too many log arguments");
+		LogRecord record;
+		record.format = format;
+		record.argumentCount = 0;
+		int unpack[] = { 0, (store(record, values), 0)... };
+		(void)unpack;
+		if (!queue.push(record)) dropped.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// минимальный промежуток между одинаковыми сообщениями, 0 - печатать все
+	void setRateLimit(std::chrono::milliseconds interval)
+	{
+		rateLimit.store(interval.count(), std::memory_order_relaxed);
+	}
+
+	std::uint64_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+
+	// дождаться вывода всего, что уже записано (например, перед печатью напрямую в std::cout)
+	void flush()
+	{
+		std::uint64_t target = requested.fetch_add(1, std::memory_order_acq_rel) + 1;
+		while (completed.load(std::memory_order_acquire) < target) std::this_thread::sleep_for(std::chrono::microseconds(200));
+	}
+
+	AsyncLog(const AsyncLog&) = delete;
+	AsyncLog& operator=(const AsyncLog&) = delete;
+
+private:
+	// последнее схлопнутое сообщение с таким шаблоном
+	struct Repeated
+	{
+		Clock::time_point lastPrinted;
+		LogRecord latest;
+		int skipped = 0;
+	};
+
+	AsyncLog()
+		: worker([this] { run(); })
+	{
+	}
+
+	~AsyncLog()
+	{
+		running.store(false, std::memory_order_release);
+		worker.join();
+	}
+
+	template <typename T>
+	static void store(LogRecord& record, T value)
+	{
+		static_assert(std::is_arithmetic<T>::value, "only numbers can be logged");
+		LogRecord::Argument& argument = record.arguments[record.argumentCount++];
+		argument.isInteger = std::is_integral<T>::value;
+		if (argument.isInteger) argument.integer = static_cast<long long>(value);
+		else argument.real = static_cast<double>(value);
+	}
+
+	void run()
+	{
+		const auto wakeInterval = std::chrono::milliseconds(5); // как часто поток вывода просыпается сам
+		bool stopping = false;
+		while (!stopping)
+		{
+			stopping = !running.load(std::memory_order_acquire);
+			std::uint64_t flushTarget = requested.load(std::memory_order_acquire);
+			bool forceRepeated = stopping || flushTarget > completed.load(std::memory_order_relaxed);
+
+			bool printed = drain();
+			printed |= printRepeated(forceRepeated);
+			std::uint64_t droppedNow = dropped.load(std::memory_order_relaxed);
+			if (droppedNow != droppedReported)
+			{
+				std::cout << "Log: " << droppedNow - droppedReported << " messages dropped (queue full)\n";
+				droppedReported = droppedNow;
+				printed = true;
+			}
+			if (printed) std::cout.flush();
+
+			completed.store(flushTarget, std::memory_order_release);
+			if (!stopping) std::this_thread::sleep_for(wakeInterval);
+		}
+	}
+
+	bool drain()
+	{
+		bool printed = false;
+		LogRecord record;
+		Clock::time_point now = Clock::now();
+		Clock::duration interval = std::chrono::milliseconds(rateLimit.load(std::memory_order_relaxed));
+		while (queue.pop(record))
+		{
+			if (interval.count() > 0)
+			{
+				Repeated& repeated = lastByFormat[record.format];
+				if (repeated.lastPrinted != Clock::time_point() && now - repeated.lastPrinted < interval)
+				{
+					repeated.latest = record;
+					++repeated.skipped;
+					continue;
+				}
+				repeated.lastPrinted = now;
+				print(record, repeated.skipped);
+				repeated.skipped = 0;
+			}
+			else
+			{
+				print(record, 0);
+			}
+			printed = true;
+		}
+		return printed;
+	}
+
+	// печатаем схлопнутые сообщения, для которых истек промежуток (или все сразу при выходе и flush)
+	bool printRepeated(bool force)
+	{
+		bool printed = false;
+		Clock::time_point now = Clock::now();
+		Clock::duration interval = std::chrono::milliseconds(rateLimit.load(std::memory_order_relaxed));
+		for (auto& entry : lastByFormat)
+		{
+			Repeated& repeated = entry.second;
+			if (repeated.skipped == 0 || (!force && now - repeated.lastPrinted < interval)) continue;
+			print(repeated.latest, repeated.skipped - 1);
+			repeated.lastPrinted = now;
+			repeated.skipped = 0;
+			printed = true;
+		}
+		return printed;
+	}
+
+	static void print(const LogRecord& record, int skipped)
+	{
+		int next = 0;
+		for (const char* c = record.format; *c != '\0'; ++c)
+		{
+			if (c[0] == '{' && c[1] == '}' && next < record.argumentCount)
+			{
+				const LogRecord::Argument& argument = record.arguments[next++];
+				if (argument.isInteger) std::cout << argument.integer;
+				else std::cout << argument.real;
+				++c;
+			}
+			else
+			{
+				std::cout << *c;
+			}
+		}
+		if (skipped > 0) std::cout << " (" << skipped << " similar skipped)";
+		std::cout << '\n';
+	}
+
+	LogQueue queue;
+	std::atomic<std::uint64_t> dropped{ 0 };
+	std::atomic<long long> rateLimit{ 100 };
+	std::atomic<bool> running{ true };
+	std::atomic<std::uint64_t> requested{ 0 }; // номер последнего запроса flush
+	std::atomic<std::uint64_t> completed{ 0 }; // номер последнего выполненного
+	std::uint64_t droppedReported = 0;
+	std::unordered_map<const char*, Repeated> lastByFormat; // только фоновый поток
+	std::thread worker; // последним: поток запускается, когда все остальное уже создано
+};
@@ -0,0 +1,75 @@
+// время этапа на видеокарте через запросы таймера OpenGL (нужен GLEW и OpenGL 3.3 или ARB_timer_query)
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include "profiler.hpp"
+
+// Результат запроса готов только через несколько кадров, поэтому запросы идут по кругу,
+// а готовые результаты забираются без ожидания и попадают в профилировщик с номером своего кадра.
+// Запросы GL_TIME_ELAPSED не вкладываются друг в друга: одновременно может идти только один этап.
+class GpuStageTimer
+{
+public:
+	explicit GpuStageTimer(const char* name)
+		: stage(FrameProfiler::instance().stage(name))
+	{
+		available = FrameProfiler::instance().isEnabled() && (GLEW_VERSION_3_3 || GLEW_ARB_timer_query);
+		if (available) glGenQueries(QUERY_COUNT, queries);
+	}
+
+	~GpuStageTimer()
+	{
+		if (available) glDeleteQueries(QUERY_COUNT, queries);
+	}
+
+	GpuStageTimer(const GpuStageTimer&) = delete;
+	GpuStageTimer& operator=(const GpuStageTimer&) = delete;
+
+	void begin()
+	{
+		collect();
+		if (!available || pending[next]) return; // все запросы еще в работе - этот кадр пропускаем
+		glBeginQuery(GL_TIME_ELAPSED, queries[next]);
+		active = true;
+	}
+
+	void end()
+	{
+		if (!active) return;
+		glEndQuery(GL_TIME_ELAPSED);
+		pending[next] = true;
+		frames[next] = FrameProfiler::instance().currentFrame();
+		next = (next + 1) % QUERY_COUNT;
+		active = false;
+	}
+
+private:
+	static const int QUERY_COUNT = 4;
+
+	// забираем готовые результаты, начиная с самого старого запроса
+	void collect()
+	{
+		for (int i = 0; i < QUERY_COUNT; ++i)
+		{
+			int index = (next + i) % QUERY_COUNT;
+			if (!pending[index]) continue;
+			GLint ready = 0;
+			glGetQueryObjectiv(queries[index], GL_QUERY_RESULT_AVAILABLE, &ready);
+			if (!ready) break;
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(queries[index], GL_QUERY_RESULT, &elapsed);
+			FrameProfiler::instance().record(stage, 0, static_cast<std::int64_t>(elapsed), true, frames[index]);
+			pending[index] = false;
+		}
+	}
+
+	int stage;
+	bool available = false;
+	bool active = false;
+	GLuint queries[QUERY_COUNT] = {};
+	bool pending[QUERY_COUNT] = {};
+	std::uint32_t frames[QUERY_COUNT] = {};
+	int next = 0;
+};
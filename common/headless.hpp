@@ -0,0 +1,240 @@
+// рисование без окна: контекст OpenGL через EGL, кадр в объекте кадрового буфера, чтение последнего кадра через PBO
+
+#pragma once
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if __has_include(<EGL/egl.h>)
+#define EGL_NO_X11               // заголовки X11 не нужны (и их макросы вроде None ломают SFML)
+#define MESA_EGL_NO_X11_HEADERS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#define HEADLESS_HAS_EGL 1
+#endif
+
+// Режим без окна для машин без дисплея: --headless [кадры] [файл.ppm].
+// Контекст создается через EGL без поверхности (на Mesa - платформа surfaceless, подходит и программный llvmpipe),
+// кадры рисуются в объект кадрового буфера. После последнего кадра glReadPixels пишет в буфер пикселей (PBO)
+// и сразу возвращается; файл пишется, когда видеокарта закончит, вместе со статистикой времени кадров.
+// В цикле лаборатории объект заменяет окно: isOpen() и display()
+class HeadlessRenderer
+{
+public:
+	HeadlessRenderer() = default;
+	HeadlessRenderer(const HeadlessRenderer&) = delete;
+	HeadlessRenderer& operator=(const HeadlessRenderer&) = delete;
+
+	~HeadlessRenderer()
+	{
+		if (pixelBuffer != 0) glDeleteBuffers(1, &pixelBuffer);
+		if (framebuffer != 0) glDeleteFramebuffers(1, &framebuffer);
+		if (renderbuffers[0] != 0) glDeleteRenderbuffers(2, renderbuffers);
+#ifdef HEADLESS_HAS_EGL
+		if (eglDisplay != EGL_NO_DISPLAY)
+		{
+			eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+			if (eglContext != EGL_NO_CONTEXT) eglDestroyContext(eglDisplay, eglContext);
+			eglTerminate(eglDisplay);
+		}
+#endif
+	}
+
+	// ищет --headless среди параметров запуска; без него режим выключен
+	void configure(int argc, char* argv[], const std::string& defaultFile, int defaultFrames = 300)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			if (std::string(argv[i]) != "--headless") continue;
+			enabled = true;
+			frames = defaultFrames;
+			outputFile = defaultFile;
+			if (i + 1 < argc && argv[i + 1][0] != '-') frames = std::max(1, std::atoi(argv[++i]));
+			if (i + 1 < argc && argv[i + 1][0] != '-') outputFile = argv[++i];
+		}
+	}
+
+	bool isEnabled() const { return enabled; }
+
+	// контекст и кадровый буфер width x height с глубиной 24 бита; false - режим недоступен (сообщение в std::cerr)
+	bool create(int frameWidth, int frameHeight)
+	{
+		width = frameWidth;
+		height = frameHeight;
+		if (!createContext()) return false;
+		glewExperimental = GL_TRUE;
+		glewInit(); // у GLEW, собранного для GLX, код ошибки без дисплея ненадежен - проверяем нужные функции сами
+		if (!(GLEW_VERSION_3_0 || GLEW_ARB_framebuffer_object))
+		{
+			std::cerr << "Headless: framebuffer objects are not available" << std::endl;
+			return false;
+		}
+
+		glGenFramebuffers(1, &framebuffer);
+		glGenRenderbuffers(2, renderbuffers);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+		glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			std::cerr << "Headless: framebuffer is incomplete" << std::endl;
+			return false;
+		}
+		glViewport(0, 0, width, height);
+
+		glGenBuffers(1, &pixelBuffer);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(width) * height * 4, nullptr, GL_STREAM_READ);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		std::cout << "Headless: " << glGetString(GL_RENDERER) << ", OpenGL " << glGetString(GL_VERSION)
+			<< ", " << width << "x" << height << ", " << frames << " frames" << std::endl;
+		start = previous = Clock::now();
+		return true;
+	}
+
+	bool isOpen() const { return frame < frames; }
+
+	// вместо window.display(): время кадра, а после последнего - запрос чтения пикселей без ожидания
+	void display()
+	{
+		Clock::time_point now = Clock::now();
+		frameTimes.push_back(std::chrono::duration<double, std::milli>(now - previous).count());
+		previous = now;
+		if (++frame < frames) return;
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffer);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadBuffer(GL_COLOR_ATTACHMENT0);
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		readFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glFlush();
+	}
+
+	// после цикла: дождаться пикселей, записать кадр и вывести время; false, если файл не записался
+	bool finish()
+	{
+		if (readFence == nullptr) return false;
+		GLenum result = glClientWaitSync(readFence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		while (result == GL_TIMEOUT_EXPIRED) result = glClientWaitSync(readFence, 0, 1000000000);
+		glDeleteSync(readFence);
+		readFence = nullptr;
+		double totalTime = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffer);
+		const unsigned char* pixels = static_cast<const unsigned char*>(
+			glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(width) * height * 4, GL_MAP_READ_BIT));
+		bool written = pixels != nullptr && writePpm(pixels);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		printStats(totalTime);
+		if (!written)
+		{
+			std::cerr << "Headless: cannot write " << outputFile << std::endl;
+			return false;
+		}
+		std::cout << "Frame saved to " << outputFile << std::endl;
+		return true;
+	}
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	bool createContext()
+	{
+#ifdef HEADLESS_HAS_EGL
+		// платформа surfaceless не требует ни X11, ни Wayland, ни устройства DRM
+		const char* extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+		auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+		if (extensions != nullptr && std::strstr(extensions, "EGL_MESA_platform_surfaceless") != nullptr && getPlatformDisplay != nullptr)
+			eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+		if (eglDisplay == EGL_NO_DISPLAY) eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+		EGLint major = 0, minor = 0;
+		if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, &major, &minor) || !eglBindAPI(EGL_OPENGL_API))
+		{
+			std::cerr << "Headless: cannot initialize EGL" << std::endl;
+			return false;
+		}
+
+		// поверхность не нужна (рисуем в свой кадровый буфер), поэтому конфигурация тоже может не найтись
+		const EGLint configAttributes[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+		EGLConfig config = nullptr;
+		EGLint configCount = 0;
+		if (!eglChooseConfig(eglDisplay, configAttributes, &config, 1, &configCount) || configCount == 0) config = nullptr;
+		eglContext = eglCreateContext(eglDisplay, config, EGL_NO_CONTEXT, nullptr); // профиль совместимости: лабораториям нужен и glBegin
+		if (eglContext == EGL_NO_CONTEXT || !eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext))
+		{
+			std::cerr << "Headless: cannot create a surfaceless OpenGL context (EGL error 0x" << std::hex << eglGetError() << std::dec << ")" << std::endl;
+			return false;
+		}
+		return true;
+#else
+		std::cerr << "Headless: EGL is not available in this build" << std::endl;
+		return false;
+#endif
+	}
+
+	// P6 PPM, строки сверху вниз (в OpenGL первая строка - нижняя)
+	bool writePpm(const unsigned char* rgba) const
+	{
+		std::ofstream file(outputFile, std::ios::binary);
+		file << "P6\n" << width << " " << height << "\n255\n";
+		std::vector<char> row(static_cast<size_t>(width) * 3);
+		for (int y = height - 1; y >= 0; --y)
+		{
+			const unsigned char* source = rgba + static_cast<size_t>(y) * width * 4;
+			for (int x = 0; x < width; ++x)
+			{
+				row[x * 3] = static_cast<char>(source[x * 4]);
+				row[x * 3 + 1] = static_cast<char>(source[x * 4 + 1]);
+				row[x * 3 + 2] = static_cast<char>(source[x * 4 + 2]);
+			}
+			file.write(row.data(), row.size());
+		}
+		return static_cast<bool>(file);
+	}
+
+	// время кадров на процессоре (отправка команд) и общее время вместе с ожиданием видеокарты
+	void printStats(double totalTime)
+	{
+		if (frameTimes.empty()) return;
+		std::vector<double> sorted = frameTimes;
+		std::sort(sorted.begin(), sorted.end());
+		double sum = 0.0;
+		for (double time : sorted) sum += time;
+		std::cout << "Frames: " << sorted.size() << ", total " << totalTime << " ms (" << sorted.size() * 1000.0 / totalTime << " fps)" << std::endl;
+		std::cout << "Frame time (ms): avg " << sum / sorted.size()
+			<< ", min " << sorted.front()
+			<< ", median " << sorted[sorted.size() / 2]
+			<< ", max " << sorted.back() << std::endl;
+	}
+
+	bool enabled = false;
+	int frames = 0;
+	int frame = 0;
+	std::string outputFile;
+	int width = 0, height = 0;
+#ifdef HEADLESS_HAS_EGL
+	EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+	EGLContext eglContext = EGL_NO_CONTEXT;
+#endif
+	GLuint framebuffer = 0;
+	GLuint renderbuffers[2] = { 0, 0 }; // цвет и глубина
+	GLuint pixelBuffer = 0;
+	GLsync readFence = nullptr;
+	Clock::time_point start, previous;
+	std::vector<double> frameTimes;
+};
@@ -0,0 +1,83 @@
+// микробенчмарки отдельных функций: время одного вызова и пропускная способность, общие для всех лабораторных
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+// Результат вызова должен "использоваться", иначе компилятор выбросит весь вызов как лишний
+template <typename T>
+inline void keepResult(const T& value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	asm volatile("" : : "r,m"(value) : "memory");
+#else
+	// адрес уходит в volatile-указатель, а барьер не дает отложить или выбросить запись самого value перед ним
+	static const void* volatile sink;
+	sink = &value;
+#if defined(_MSC_VER)
+	_ReadWriteBarrier();
+#endif
+#endif
+}
+
+// Набор замеров, запускаемый из режима --kernel-bench лабораторной. Функция вызывается с номером итерации
+// (вход берется из заранее заполненного массива размером в степень двойки: i & (размер - 1)),
+// число итераций подбирается так, чтобы замер шел около MIN_TIME; из REPEATS замеров берется лучший - он меньше всех искажен другими процессами.
+// Входы заполняются генератором с фиксированным зерном, поэтому запуски до и после изменения функции сравнимы
+class MicroBenchmark
+{
+public:
+	static constexpr double MIN_TIME = 0.05; // секунд на один замер
+	static constexpr int REPEATS = 5;
+
+	// filter - выполнять только замеры, в имени которых есть эта строка (пустая - все)
+	explicit MicroBenchmark(std::string filter = "")
+		: filter(std::move(filter))
+	{
+		std::cout << std::left << std::setw(NAME_WIDTH) << "Benchmark" << std::right
+			<< std::setw(12) << "ns/op" << std::setw(14) << "Mops/s" << std::setw(16) << "Mitems/s" << std::endl;
+	}
+
+	// itemsPerOp - сколько элементов (точек, вершин, лучей) обрабатывает один вызов, для пропускной способности
+	template <typename Kernel>
+	void run(const std::string& name, Kernel kernel, double itemsPerOp = 1.0)
+	{
+		if (!filter.empty() && name.find(filter) == std::string::npos) return;
+
+		// подбор числа итераций: удваиваем, пока замер короче MIN_TIME
+		size_t iterations = 1;
+		while (measure(kernel, iterations) < MIN_TIME && iterations < (size_t(1) << 40)) iterations *= 2;
+
+		double best = 1e30;
+		for (int repeat = 0; repeat < REPEATS; ++repeat) best = std::min(best, measure(kernel, iterations));
+		double nanoseconds = best * 1e9 / iterations;
+		std::cout << std::left << std::setw(NAME_WIDTH) << name << std::right << std::fixed << std::setprecision(2)
+			<< std::setw(12) << nanoseconds
+			<< std::setprecision(4) << std::setw(14) << 1e3 / nanoseconds // у вызовов на весь набор точек это тысячные доли
+			<< std::setprecision(2) << std::setw(16) << itemsPerOp * 1e3 / nanoseconds << std::defaultfloat << std::endl;
+	}
+
+private:
+	static constexpr int NAME_WIDTH = 48;
+
+	template <typename Kernel>
+	static double measure(Kernel& kernel, size_t iterations)
+	{
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < iterations; ++i) kernel(i);
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	std::string filter;
+};
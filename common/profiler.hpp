@@ -0,0 +1,301 @@
+// замер времени этапов кадра (ввод, обновление, отрисовка, вывод) для всех лабораторных
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Один замер: этап, кадр, поток и время в наносекундах от запуска профилировщика
+struct ProfileSample
+{
+	std::int64_t start;
+	std::int64_t duration;
+	std::uint32_t frame;
+	std::uint16_t stage;
+	std::uint8_t thread;
+	std::uint8_t gpu; // 1 - время на видеокарте (запрос таймера OpenGL)
+};
+
+// Кольцо замеров одного потока: пишет только этот поток, читает только сборщик, блокировок нет.
+// Если сборщик не успевает, новые замеры отбрасываются и считаются.
+class ProfileRing
+{
+public:
+	static constexpr std::uint32_t CAPACITY = 4096; // степень двойки
+
+	explicit ProfileRing(std::uint8_t thread)
+		: thread(thread), samples(CAPACITY)
+	{
+	}
+
+	bool push(const ProfileSample& sample)
+	{
+		std::uint32_t currentHead = head.load(std::memory_order_relaxed);
+		if (currentHead - tail.load(std::memory_order_acquire) >= CAPACITY)
+		{
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		samples[currentHead & (CAPACITY - 1)] = sample;
+		head.store(currentHead + 1, std::memory_order_release);
+		return true;
+	}
+
+	template <typename Visitor>
+	void drain(Visitor visit)
+	{
+		std::uint32_t currentTail = tail.load(std::memory_order_relaxed);
+		std::uint32_t currentHead = head.load(std::memory_order_acquire);
+		for (; currentTail != currentHead; ++currentTail)
+		{
+			visit(samples[currentTail & (CAPACITY - 1)]);
+		}
+		tail.store(currentTail, std::memory_order_release);
+	}
+
+	std::uint64_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+
+	const std::uint8_t thread;
+
+private:
+	std::vector<ProfileSample> samples;
+	std::atomic<std::uint32_t> head{ 0 };
+	std::atomic<std::uint32_t> tail{ 0 };
+	std::atomic<std::uint64_t> dropped{ 0 };
+};
+
+// Профилировщик кадров. Выключен, пока не вызван configure с --profile, и тогда замеры почти ничего не стоят.
+// Главный поток отмечает кадры (endFrame), собирает замеры всех потоков, раз в reportInterval кадров печатает
+// сводку по этапам (среднее, 95-й процентиль, максимум) и, если задан файл, дописывает все замеры в CSV.
+class FrameProfiler
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	static FrameProfiler& instance()
+	{
+		static FrameProfiler profiler;
+		return profiler;
+	}
+
+	// --profile [файл.csv] в любом месте командной строки включает профилировщик
+	void configure(int argc, char* argv[], int reportFrames = 300)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			if (std::string(argv[i]) != "--profile") continue;
+			enable(i + 1 < argc && argv[i + 1][0] != '-' ? argv[i + 1] : "", reportFrames);
+		}
+	}
+
+	void enable(const std::string& csvFile, int reportFrames)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		reportInterval = reportFrames;
+		if (!csvFile.empty())
+		{
+			csv.open(csvFile);
+			if (csv) csv << "frame,thread,stage,source,start_us,duration_us\n";
+			else std::cerr << "Profiler: cannot create " << csvFile << std::endl;
+		}
+		enabled.store(true, std::memory_order_release);
+	}
+
+	bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+	// номер этапа по имени (для одного имени всегда один номер)
+	int stage(const char* name)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (size_t i = 0; i < stages.size(); ++i)
+		{
+			if (stages[i].name == name) return static_cast<int>(i);
+		}
+		stages.push_back(StageStats());
+		stages.back().name = name;
+		return static_cast<int>(stages.size() - 1);
+	}
+
+	std::int64_t now() const
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - origin).count();
+	}
+
+	std::uint32_t currentFrame() const { return frame.load(std::memory_order_relaxed); }
+
+	void record(int stageId, std::int64_t start, std::int64_t duration, bool gpu = false, std::uint32_t sampleFrame = 0xFFFFFFFFu)
+	{
+		ProfileRing& ring = threadRing();
+		ProfileSample sample;
+		sample.start = start;
+		sample.duration = duration;
+		sample.frame = sampleFrame != 0xFFFFFFFFu ? sampleFrame : currentFrame();
+		sample.stage = static_cast<std::uint16_t>(stageId);
+		sample.thread = ring.thread;
+		sample.gpu = gpu ? 1 : 0;
+		ring.push(sample);
+	}
+
+	// конец кадра главного потока: собираем замеры и при необходимости печатаем сводку
+	void endFrame()
+	{
+		if (!isEnabled()) return;
+		std::uint32_t finished = frame.fetch_add(1, std::memory_order_relaxed) + 1;
+		collect();
+		if (reportInterval > 0 && finished % reportInterval == 0) report(std::cout);
+	}
+
+	// сводка по этапам за кадры после прошлой сводки
+	void report(std::ostream& out)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		std::uint64_t dropped = 0;
+		for (const auto& ring : rings) dropped += ring->droppedCount();
+
+		out << "Profile, frames " << currentFrame() << (dropped > 0 ? ", dropped samples " + std::to_string(dropped) : "") << std::endl;
+		out << std::fixed << std::setprecision(3);
+		for (StageStats& stats : stages)
+		{
+			printStats(out, stats.name, stats.cpu);
+			printStats(out, stats.name + " (gpu)", stats.gpu);
+		}
+		out.unsetf(std::ios::fixed);
+		out << std::setprecision(6);
+	}
+
+	// последняя сводка и сброс CSV на диск при выходе
+	void finish()
+	{
+		if (!isEnabled()) return;
+		collect();
+		report(std::cout);
+		std::lock_guard<std::mutex> lock(mutex);
+		if (csv.is_open()) csv.flush();
+	}
+
+private:
+	struct Durations
+	{
+		std::vector<double> milliseconds; // замеры с прошлой сводки
+	};
+
+	struct StageStats
+	{
+		std::string name;
+		Durations cpu, gpu;
+	};
+
+	FrameProfiler()
+		: origin(Clock::now())
+	{
+	}
+
+	ProfileRing& threadRing()
+	{
+		thread_local ProfileRing* ring = nullptr;
+		if (ring == nullptr)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			rings.emplace_back(new ProfileRing(static_cast<std::uint8_t>(rings.size())));
+			ring = rings.back().get();
+		}
+		return *ring;
+	}
+
+	// забираем замеры из колец всех потоков
+	void collect()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (const auto& ring : rings)
+		{
+			ring->drain([this](const ProfileSample& sample)
+			{
+				if (sample.stage >= stages.size()) return;
+				Durations& target = sample.gpu ? stages[sample.stage].gpu : stages[sample.stage].cpu;
+				target.milliseconds.push_back(sample.duration / 1.0e6);
+				if (csv.is_open())
+				{
+					csv << sample.frame << ',' << int(sample.thread) << ',' << stages[sample.stage].name << ','
+						<< (sample.gpu ? "gpu" : "cpu") << ',' << sample.start / 1000 << ',' << sample.duration / 1000.0 << '\n';
+				}
+			});
+		}
+	}
+
+	static void printStats(std::ostream& out, const std::string& name, Durations& durations)
+	{
+		std::vector<double>& values = durations.milliseconds;
+		if (values.empty()) return;
+		std::sort(values.begin(), values.end());
+		double total = 0.0;
+		for (double value : values) total += value;
+		out << "  " << std::left << std::setw(20) << name << std::right
+			<< " avg " << std::setw(8) << total / values.size()
+			<< " ms, p95 " << std::setw(8) << values[std::min(values.size() - 1, values.size() * 95 / 100)]
+			<< " ms, max " << std::setw(8) << values.back()
+			<< " ms, samples " << values.size() << std::endl;
+		values.clear();
+	}
+
+	const Clock::time_point origin;
+	std::atomic<bool> enabled{ false };
+	std::atomic<std::uint32_t> frame{ 0 };
+	int reportInterval = 300;
+	std::mutex mutex; // защищает список этапов, список колец и файл (замеры пишутся в кольца без него)
+	std::vector<StageStats> stages;
+	std::vector<std::unique_ptr<ProfileRing>> rings;
+	std::ofstream csv;
+};
+
+// Замер времени от создания до stop() или до конца области видимости
+class ProfileScope
+{
+public:
+	explicit ProfileScope(int stage)
+		: stage(stage), start(FrameProfiler::instance().isEnabled() ? FrameProfiler::instance().now() : -1)
+	{
+	}
+
+	~ProfileScope()
+	{
+		stop();
+	}
+
+	// закончить замер раньше конца области видимости
+	void stop()
+	{
+		if (start < 0) return;
+		FrameProfiler& profiler = FrameProfiler::instance();
+		profiler.record(stage, start, profiler.now() - start);
+		start = -1;
+	}
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+	int stage;
+	std::int64_t start;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+// PROFILE_SCOPE("draw"); - замер до конца текущего блока (имя этапа регистрируется один раз)
+#define PROFILE_SCOPE(name) \
+	static const int PROFILE_CONCAT(profileStage, __LINE__) = FrameProfiler::instance().stage(name); \
+	ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(PROFILE_CONCAT(profileStage, __LINE__))
+
+// PROFILE_BEGIN(inputTimer, "input"); ... inputTimer.stop(); - замер части блока
+#define PROFILE_BEGIN(variable, name) \
+	static const int PROFILE_CONCAT(variable, Stage) = FrameProfiler::instance().stage(name); \
+	ProfileScope variable(PROFILE_CONCAT(variable, Stage))
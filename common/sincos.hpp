@@ -0,0 +1,64 @@
+// быстрые синус и косинус (скалярные и по четыре значения SSE2), общие для всех лабораторных
+
+#pragma once
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SINCOS_USE_SSE2 1
+#endif
+
+// Синус и косинус одного угла: приведение к [-pi/4, pi/4] по четвертям и многочлены (как в cephes sinf/cosf).
+// Точность порядка 1e-7 для углов до нескольких тысяч радиан.
+inline void sinCos(float x, float& sinValue, float& cosValue)
+{
+	float j = static_cast<float>(static_cast<int>(x * 0.63661977236f + (x >= 0.0f ? 0.5f : -0.5f))); // номер четверти
+	int quadrant = static_cast<int>(j) & 3;
+	float r = ((x - j * 1.5703125f) - j * 4.837512969970703125e-4f) - j * 7.54978995489188216e-8f;
+	float r2 = r * r;
+
+	float s = r + r * r2 * (-1.6666654611e-1f + r2 * (8.3321608736e-3f + r2 * -1.9515295891e-4f));
+	float c = 1.0f - 0.5f * r2 + r2 * r2 * (4.166664568298827e-2f + r2 * (-1.388731625493765e-3f + r2 * 2.443315711809948e-5f));
+
+	switch (quadrant)
+	{
+	case 0: sinValue = s; cosValue = c; break;
+	case 1: sinValue = c; cosValue = -s; break;
+	case 2: sinValue = -s; cosValue = -c; break;
+	default: sinValue = -c; cosValue = s; break;
+	}
+}
+
+#ifdef SINCOS_USE_SSE2
+// то же самое для четырех углов сразу
+inline void sinCos4(__m128 x, __m128& sinValue, __m128& cosValue)
+{
+	__m128i j = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(0.63661977236f))); // округление к ближайшему
+	__m128 jf = _mm_cvtepi32_ps(j);
+	__m128 r = _mm_sub_ps(x, _mm_mul_ps(jf, _mm_set1_ps(1.5703125f)));
+	r = _mm_sub_ps(r, _mm_mul_ps(jf, _mm_set1_ps(4.837512969970703125e-4f)));
+	r = _mm_sub_ps(r, _mm_mul_ps(jf, _mm_set1_ps(7.54978995489188216e-8f)));
+	__m128 r2 = _mm_mul_ps(r, r);
+
+	__m128 sPoly = _mm_add_ps(_mm_set1_ps(8.3321608736e-3f), _mm_mul_ps(r2, _mm_set1_ps(-1.9515295891e-4f)));
+	sPoly = _mm_add_ps(_mm_set1_ps(-1.6666654611e-1f), _mm_mul_ps(r2, sPoly));
+	__m128 s = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, r2), sPoly));
+
+	__m128 cPoly = _mm_add_ps(_mm_set1_ps(-1.388731625493765e-3f), _mm_mul_ps(r2, _mm_set1_ps(2.443315711809948e-5f)));
+	cPoly = _mm_add_ps(_mm_set1_ps(4.166664568298827e-2f), _mm_mul_ps(r2, cPoly));
+	__m128 c = _mm_add_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_set1_ps(0.5f), r2)), _mm_mul_ps(_mm_mul_ps(r2, r2), cPoly));
+
+	// в нечетных четвертях синус и косинус меняются местами
+	__m128i quadrant = _mm_and_si128(j, _mm_set1_epi32(3));
+	__m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+	__m128 sinBase = _mm_or_ps(_mm_and_ps(swap, c), _mm_andnot_ps(swap, s));
+	__m128 cosBase = _mm_or_ps(_mm_and_ps(swap, s), _mm_andnot_ps(swap, c));
+
+	// знак синуса меняется в четвертях 2 и 3, знак косинуса - в 1 и 2
+	__m128 signBit = _mm_set1_ps(-0.0f);
+	__m128 sinNegative = _mm_castsi128_ps(_mm_cmpgt_epi32(quadrant, _mm_set1_epi32(1)));
+	__m128i cosFlip = _mm_xor_si128(_mm_and_si128(quadrant, _mm_set1_epi32(1)), _mm_srli_epi32(quadrant, 1));
+	__m128 cosNegative = _mm_castsi128_ps(_mm_cmpeq_epi32(cosFlip, _mm_set1_epi32(1)));
+	sinValue = _mm_xor_ps(sinBase, _mm_and_ps(sinNegative, signBit));
+	cosValue = _mm_xor_ps(cosBase, _mm_and_ps(cosNegative, signBit));
+}
+#endif
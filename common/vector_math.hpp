@@ -0,0 +1,196 @@
+// векторы и матрицы для всех лабораторных: Vec2, Vec3, Vec4, Mat4 (SSE2 или NEON) и пакетные операции над массивами
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VECMATH_USE_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define VECMATH_USE_NEON 1
+#endif
+
+// угол в радианах по углу в градусах
+constexpr float radians(float degrees) { return degrees * 0.01745329251994329576923690768489f; }
+
+// Точка на плоскости (например, в пикселях экрана)
+struct Vec2
+{
+	float x, y;
+
+	constexpr Vec2() : x(0.0f), y(0.0f) {}
+	constexpr Vec2(float x, float y) : x(x), y(y) {}
+};
+
+// Точка или направление из трех чисел, без выравнивания: 12 байт, как вершина в массиве или glVertex3f.
+// Одиночные операции скалярные (для трех чисел загрузка в регистр SSE не окупается) и constexpr, где это возможно;
+// быстрые циклы обрабатывают массивы векторов пакетными функциями ниже. normalize делит на длину, а не умножает
+// на обратную - тот же результат, что у прежних Vector3 в L2 и L5
+struct Vec3
+{
+	float x, y, z;
+
+	constexpr Vec3() : x(0.0f), y(0.0f), z(0.0f) {}
+	constexpr Vec3(float x, float y, float z) : x(x), y(y), z(z) {}
+
+	constexpr Vec3 operator+(const Vec3& v) const { return Vec3(x + v.x, y + v.y, z + v.z); }
+	constexpr Vec3 operator-(const Vec3& v) const { return Vec3(x - v.x, y - v.y, z - v.z); }
+	constexpr Vec3 operator-() const { return Vec3(-x, -y, -z); }
+	constexpr Vec3 operator*(float s) const { return Vec3(x * s, y * s, z * s); }
+	constexpr Vec3 operator*(const Vec3& v) const { return Vec3(x * v.x, y * v.y, z * v.z); } // покомпонентно
+	constexpr Vec3 operator/(float s) const { return Vec3(x / s, y / s, z / s); }
+	Vec3& operator+=(const Vec3& v) { x += v.x; y += v.y; z += v.z; return *this; }
+
+	constexpr float dot(const Vec3& v) const { return x * v.x + y * v.y + z * v.z; }
+	constexpr Vec3 cross(const Vec3& v) const { return Vec3(y * v.z - z * v.y, z * v.x - x * v.z, x * v.y - y * v.x); }
+	float length() const { return std::sqrt(dot(*this)); }
+	Vec3 normalize() const { return *this / length(); } // единичный вектор того же направления
+};
+
+constexpr Vec3 operator*(float s, const Vec3& v) { return v * s; }
+constexpr float dot(const Vec3& a, const Vec3& b) { return a.dot(b); }
+constexpr Vec3 cross(const Vec3& a, const Vec3& b) { return a.cross(b); }
+inline float length(const Vec3& v) { return v.length(); }
+inline Vec3 normalize(const Vec3& v) { return v.normalize(); }
+
+// Четыре числа, выровненные на 16 байт: одна загрузка в регистр SSE/NEON. Однородные координаты и строки/столбцы Mat4
+struct alignas(16) Vec4
+{
+	float x, y, z, w;
+
+	constexpr Vec4() : x(0.0f), y(0.0f), z(0.0f), w(0.0f) {}
+	constexpr Vec4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {}
+	constexpr Vec4(const Vec3& v, float w) : x(v.x), y(v.y), z(v.z), w(w) {}
+
+	float* data() { return &x; }
+	const float* data() const { return &x; }
+
+	Vec4 operator+(const Vec4& v) const;
+	Vec4 operator-(const Vec4& v) const;
+	Vec4 operator-() const { return Vec4() - *this; }
+	Vec4 operator*(float s) const;
+};
+
+#if defined(VECMATH_USE_SSE2)
+inline Vec4 vec4FromRegister(__m128 value) { Vec4 result; _mm_store_ps(result.data(), value); return result; }
+inline Vec4 Vec4::operator+(const Vec4& v) const { return vec4FromRegister(_mm_add_ps(_mm_load_ps(data()), _mm_load_ps(v.data()))); }
+inline Vec4 Vec4::operator-(const Vec4& v) const { return vec4FromRegister(_mm_sub_ps(_mm_load_ps(data()), _mm_load_ps(v.data()))); }
+inline Vec4 Vec4::operator*(float s) const { return vec4FromRegister(_mm_mul_ps(_mm_load_ps(data()), _mm_set1_ps(s))); }
+#elif defined(VECMATH_USE_NEON)
+inline Vec4 vec4FromRegister(float32x4_t value) { Vec4 result; vst1q_f32(result.data(), value); return result; }
+inline Vec4 Vec4::operator+(const Vec4& v) const { return vec4FromRegister(vaddq_f32(vld1q_f32(data()), vld1q_f32(v.data()))); }
+inline Vec4 Vec4::operator-(const Vec4& v) const { return vec4FromRegister(vsubq_f32(vld1q_f32(data()), vld1q_f32(v.data()))); }
+inline Vec4 Vec4::operator*(float s) const { return vec4FromRegister(vmulq_n_f32(vld1q_f32(data()), s)); }
+#else
+inline Vec4 Vec4::operator+(const Vec4& v) const { return Vec4(x + v.x, y + v.y, z + v.z, w + v.w); }
+inline Vec4 Vec4::operator-(const Vec4& v) const { return Vec4(x - v.x, y - v.y, z - v.z, w - v.w); }
+inline Vec4 Vec4::operator*(float s) const { return Vec4(x * s, y * s, z * s, w * s); }
+#endif
+
+// Матрица 4x4 по столбцам, как в OpenGL (data() подходит для glLoadMatrixf и glUniformMatrix4fv без транспонирования)
+struct alignas(16) Mat4
+{
+	Vec4 columns[4];
+
+	constexpr Mat4() : columns{ Vec4(1, 0, 0, 0), Vec4(0, 1, 0, 0), Vec4(0, 0, 1, 0), Vec4(0, 0, 0, 1) } {} // единичная
+	constexpr Mat4(const Vec4& c0, const Vec4& c1, const Vec4& c2, const Vec4& c3) : columns{ c0, c1, c2, c3 } {}
+
+	float* data() { return columns[0].data(); }
+	const float* data() const { return columns[0].data(); }
+
+	// m * v: сумма столбцов с весами x, y, z, w
+	Vec4 operator*(const Vec4& v) const
+	{
+#if defined(VECMATH_USE_SSE2)
+		__m128 result = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(columns[0].data()), _mm_set1_ps(v.x)), _mm_mul_ps(_mm_load_ps(columns[1].data()), _mm_set1_ps(v.y))),
+			_mm_add_ps(_mm_mul_ps(_mm_load_ps(columns[2].data()), _mm_set1_ps(v.z)), _mm_mul_ps(_mm_load_ps(columns[3].data()), _mm_set1_ps(v.w))));
+		return vec4FromRegister(result);
+#elif defined(VECMATH_USE_NEON)
+		float32x4_t result = vaddq_f32(vaddq_f32(vmulq_n_f32(vld1q_f32(columns[0].data()), v.x), vmulq_n_f32(vld1q_f32(columns[1].data()), v.y)),
+			vaddq_f32(vmulq_n_f32(vld1q_f32(columns[2].data()), v.z), vmulq_n_f32(vld1q_f32(columns[3].data()), v.w)));
+		return vec4FromRegister(result);
+#else
+		return (columns[0] * v.x + columns[1] * v.y) + (columns[2] * v.z + columns[3] * v.w);
+#endif
+	}
+
+	Mat4 operator*(const Mat4& m) const
+	{
+		return Mat4(*this * m.columns[0], *this * m.columns[1], *this * m.columns[2], *this * m.columns[3]);
+	}
+
+	// точка (w = 1) в однородных координатах
+	Vec4 transformPoint(const Vec3& p) const { return *this * Vec4(p, 1.0f); }
+
+	static Mat4 translation(const Vec3& offset)
+	{
+		Mat4 result;
+		result.columns[3] = Vec4(offset, 1.0f);
+		return result;
+	}
+
+	// как gluPerspective (угол по вертикали в градусах)
+	static Mat4 perspective(float fovyDegrees, float aspect, float zNear, float zFar)
+	{
+		float f = 1.0f / std::tan(fovyDegrees * 3.14159265358979323846f / 360.0f);
+		return Mat4(Vec4(f / aspect, 0, 0, 0), Vec4(0, f, 0, 0), Vec4(0, 0, (zFar + zNear) / (zNear - zFar), -1.0f),
+			Vec4(0, 0, 2.0f * zFar * zNear / (zNear - zFar), 0));
+	}
+
+	// как gluLookAt: s = f x up, u = s x f, камера смотрит вдоль -z
+	static Mat4 lookAt(const Vec3& eye, const Vec3& center, const Vec3& up)
+	{
+		Vec3 f = (center - eye).normalize();
+		Vec3 s = f.cross(up).normalize();
+		Vec3 u = s.cross(f);
+		return Mat4(Vec4(s.x, u.x, -f.x, 0), Vec4(s.y, u.y, -f.y, 0), Vec4(s.z, u.z, -f.z, 0),
+			Vec4(-s.dot(eye), -u.dot(eye), f.dot(eye), 1.0f));
+	}
+};
+
+// ---- пакетные операции: указатель и число элементов, по четыре вектора за шаг ----
+
+// Все векторы массива - единичные, на месте. Результат совпадает с Vec3::normalize для каждого вектора
+// (корень и деление в SSE/NEON тоже точные), так что пакет можно подставлять вместо цикла без изменения картинки
+inline void normalizeBatch(Vec3* vectors, size_t count)
+{
+	static_assert(sizeof(Vec3) == 3 * sizeof(float), "Vec3 arrays are processed as packed floats");
+	size_t i = 0;
+#if defined(VECMATH_USE_SSE2)
+	// граница - число векторов, кратное четырем, а не i + 4 <= count: так компилятор точно знает, где начинается хвост
+	for (size_t packed = count & ~static_cast<size_t>(3); i < packed; i += 4)
+	{
+		// 12 чисел x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3 -> x, y, z четырех векторов
+		float* p = &vectors[i].x;
+		__m128 a = _mm_loadu_ps(p), b = _mm_loadu_ps(p + 4), c = _mm_loadu_ps(p + 8);
+		__m128 x = _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+		__m128 y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+		__m128 z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+		__m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+
+		// длины раскладываются так же, как компоненты: l0 l0 l0 l1 | l1 l1 l2 l2 | l2 l3 l3 l3
+		_mm_storeu_ps(p, _mm_div_ps(a, _mm_shuffle_ps(len, len, _MM_SHUFFLE(1, 0, 0, 0))));
+		_mm_storeu_ps(p + 4, _mm_div_ps(b, _mm_shuffle_ps(len, len, _MM_SHUFFLE(2, 2, 1, 1))));
+		_mm_storeu_ps(p + 8, _mm_div_ps(c, _mm_shuffle_ps(len, len, _MM_SHUFFLE(3, 3, 3, 2))));
+	}
+#elif defined(VECMATH_USE_NEON)
+	for (size_t packed = count & ~static_cast<size_t>(3); i < packed; i += 4)
+	{
+		float* p = &vectors[i].x;
+		float32x4x3_t v = vld3q_f32(p); // загрузка сразу раскладывает x, y, z по регистрам
+		float32x4_t len = vsqrtq_f32(vaddq_f32(vaddq_f32(vmulq_f32(v.val[0], v.val[0]), vmulq_f32(v.val[1], v.val[1])), vmulq_f32(v.val[2], v.val[2])));
+		for (int k = 0; k < 3; ++k) v.val[k] = vdivq_f32(v.val[k], len);
+		vst3q_f32(p, v);
+	}
+#endif
+	for (; i < count; ++i) vectors[i] = vectors[i].normalize();
+}
+
+// points[i] -> m * (points[i], 1) для всех точек (вершины в пространство отсечения)
+inline void transformPoints(const Mat4& m, const Vec3* points, Vec4* out, size_t count)
+{
+	for (size_t i = 0; i < count; ++i) out[i] = m.transformPoint(points[i]);
+}
@@ -0,0 +1,138 @@
+// постоянный пул потоков: задачи по индексам и деление массива на куски между потоками
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Потоки создаются один раз и ждут работы, поэтому запуск на каждом кадре стоит только пробуждения.
+// Индексы задач раздаются через атомарный счетчик. Вызовы run из разных потоков выполняются по очереди;
+// вызывать run из задачи нельзя (задача ждала бы сама себя)
+class WorkerPool
+{
+public:
+	explicit WorkerPool(unsigned threadCount)
+	{
+		// вызывающий поток тоже участвует в работе, поэтому создаем на один поток меньше
+		for (unsigned i = 1; i < threadCount; ++i)
+		{
+			workers.emplace_back([this] { workerLoop(); });
+		}
+	}
+
+	~WorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	// общий пул на все ядра для расчетов по кадрам (создается при первом обращении)
+	static WorkerPool& shared()
+	{
+		static WorkerPool pool(std::max(1u, std::thread::hardware_concurrency()));
+		return pool;
+	}
+
+	unsigned threadCount() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+	// выполняет job(i) для всех i из [0, count) и ждет завершения
+	void run(int count, const std::function<void(int)>& job)
+	{
+		std::lock_guard<std::mutex> callerLock(callerMutex);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			currentJob = &job;
+			jobCount = count;
+			nextIndex = 0;
+			busyWorkers = static_cast<int>(workers.size());
+			++generation;
+		}
+		wake.notify_all();
+
+		drain();
+
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this] { return busyWorkers == 0; });
+		currentJob = nullptr;
+	}
+
+	// kernel(begin, end) по кускам [0, count): не больше maxThreads кусков (0 - по числу потоков пула)
+	// и не меньше minChunk элементов на кусок. Границы кусков кратны четырем, чтобы каждый поток шел целыми векторами SSE
+	template <typename Kernel>
+	void parallelFor(size_t count, size_t minChunk, Kernel kernel, unsigned maxThreads = 0)
+	{
+		unsigned threads = maxThreads == 0 ? threadCount() : std::min(maxThreads, threadCount());
+		size_t parts = std::min<size_t>(threads, count / minChunk + 1);
+		if (parts <= 1)
+		{
+			kernel(static_cast<size_t>(0), count);
+			return;
+		}
+
+		size_t chunk = (count / parts + 3) & ~static_cast<size_t>(3);
+		run(static_cast<int>(parts), [&](int part)
+		{
+			size_t index = static_cast<size_t>(part);
+			size_t begin = std::min(count, index * chunk);
+			size_t end = index + 1 == parts ? count : std::min(count, (index + 1) * chunk);
+			kernel(begin, end);
+		});
+	}
+
+private:
+	void workerLoop()
+	{
+		unsigned seenGeneration = 0;
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [&] { return stopping || generation != seenGeneration; });
+				if (stopping) return;
+				seenGeneration = generation;
+			}
+
+			drain();
+
+			std::lock_guard<std::mutex> lock(mutex);
+			if (--busyWorkers == 0) done.notify_one();
+		}
+	}
+
+	// забираем задачи, пока они не кончатся
+	void drain()
+	{
+		for (int i = nextIndex.fetch_add(1); i < jobCount; i = nextIndex.fetch_add(1))
+		{
+			(*currentJob)(i);
+		}
+	}
+
+	std::vector<std::thread> workers;
+	std::mutex callerMutex; // один запуск за раз
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	const std::function<void(int)>* currentJob = nullptr;
+	int jobCount = 0;
+	std::atomic<int> nextIndex{ 0 };
+	int busyWorkers = 0;
+	unsigned generation = 0;
+	bool stopping = false;
+};